@@ -1,39 +1,98 @@
 #include "buffer.h"
+#include <string.h>
+#include <algorithm>
 
+static const char EMPTY[1] = "";
+
+Buffer::Segment Buffer::acquire_(size_t len) const {
+    Segment seg = {nullptr, 0, 0, 0};
+    seg.data = BufferPool::alloc(len, &seg.cap);
+    m_capacity += seg.cap;
+    return seg;
+}
+
+void Buffer::release_(Segment& seg) const {
+    m_capacity -= seg.cap;
+    BufferPool::free(seg.data, seg.cap);
+    seg.data = nullptr;
+}
+
+// 第一个段 FIRST_SEGMENT，之后每个比上一个大一档（4 倍），最大 MAX_SEGMENT；一次写很多时直接用够大的段
+size_t Buffer::nextSize_(size_t len) const {
+    size_t size = m_segs.empty() ? FIRST_SEGMENT : std::min(m_segs.back().cap * 4, MAX_SEGMENT);
+    return std::max(size, std::min(len, MAX_SEGMENT));
+}
+
+Buffer::Buffer() : m_readable(0), m_capacity(0) {}
+
+Buffer::~Buffer() {
+    clear_();  // 析构时已经没人在用了，哪个线程析构都可以
+}
+
+void Buffer::clear_() {
+    for (Segment& seg : m_segs) {
+        release_(seg);
+    }
+    m_segs.clear();
+    m_readable = 0;
+}
 
-Buffer::Buffer(size_t buffersize) : m_buffer(buffersize), m_readPos(0), m_writePos(0) {}
-Buffer::~Buffer() {}
 // 读写指针操作
 size_t Buffer::writeableBytes() const {
-    return m_buffer.size() - m_writePos;
+    return m_segs.empty() ? 0 : m_segs.back().cap - m_segs.back().wr;
 }
 
 size_t Buffer::readableBytes() const {
-    return m_writePos - m_readPos;
+    return m_readable;
 }
 
 size_t Buffer::prependableBytes() const {
-    return m_readPos;
+    return m_segs.empty() ? 0 : m_segs.front().rd;
 }
 
 // 写入数据函数
-void Buffer::append(const std::string& str) {
+void Buffer::append(std::string_view str) {
     append(str.data(), str.size());  // str.data()返回指向字符串首字符的指针,跟c_str()类似
 }
 
 void Buffer::append(const char* data, size_t len) {
-    ensureWriteableBytes(len);
-    std::copy(data, data + len, beginWrite());
-    m_writePos += len;
+    checkOwner_();
+    while (len > 0) {
+        if (m_segs.empty() || m_segs.back().wr == m_segs.back().cap) {
+            m_segs.push_back(acquire_(nextSize_(len)));
+        }
+        Segment& seg = m_segs.back();
+        size_t n = std::min(len, seg.cap - seg.wr);
+        memcpy(seg.data + seg.wr, data, n);
+        seg.wr += n;
+        m_readable += n;
+        data += n;
+        len -= n;
+    }
 }
 
 // 读取数据函数
 void Buffer::retrieve(size_t len) {
-    if (len < readableBytes()) {
-        m_readPos += len;
-    } else {
+    checkOwner_();
+    if (len >= m_readable) {
         retrieveAll();   // 读取所有数据，清空缓存区
+        return;
+    }
+    m_readable -= len;
+    size_t done = 0;  // 读完的段数
+    while (len > 0) {
+        Segment& seg = m_segs[done];
+        size_t n = std::min(len, seg.wr - seg.rd);
+        seg.rd += n;
+        len -= n;
+        if (seg.rd == seg.wr) {
+            done++;
+        }
+    }
+    for (size_t i = 0; i < done; i++) {
+        release_(m_segs[i]);
     }
+    m_segs.erase(m_segs.begin(), m_segs.begin() + done);
 }
 
 void Buffer::retrieveUntil(const char* end) {
@@ -41,31 +100,79 @@ void Buffer::retrieveUntil(const char* end) {
 }
 
 void Buffer::retrieveAll() {
-    m_readPos = 0;
-    m_writePos = 0;
+    checkOwner_();
+    clear_();
 }
 
 std::string Buffer::retrieveToStr(size_t len) {
-    std::string str(peek(), len);
+    checkOwner_();
+    assert(len <= m_readable);
+    std::string str;
+    str.reserve(len);
+    size_t left = len;
+    for (const Segment& seg : m_segs) {
+        if (left == 0) {
+            break;
+        }
+        size_t n = std::min(left, seg.wr - seg.rd);
+        str.append(seg.data + seg.rd, n);
+        left -= n;
+    }
     retrieve(len);  // 移动读取指针
-    // std::cout<< "str:"<<str<<std::endl;
     return str;
 }
 
 std::string Buffer::retrieveAllToStr() {
-    // std::cout<<"開始移動所有可讀字節"<<std::endl;
     return retrieveToStr(readableBytes());
 }
 
+// 完全落在删除范围里的段直接摘掉；只删一个段的一部分时，段内前后两部分移动短的那一边
+void Buffer::erase(size_t pos, size_t len) {
+    checkOwner_();
+    assert(pos + len <= m_readable);
+    m_readable -= len;
+    size_t i = 0;
+    while (len > 0) {
+        Segment& seg = m_segs[i];
+        size_t avail = seg.wr - seg.rd;
+        if (pos >= avail) {
+            pos -= avail;
+            i++;
+            continue;
+        }
+        size_t n = std::min(len, avail - pos);
+        char* begin = seg.data + seg.rd + pos;
+        if (n == avail) {
+            release_(seg);
+            m_segs.erase(m_segs.begin() + i);
+        } else {
+            size_t after = avail - pos - n;
+            if (pos <= after) {
+                memmove(seg.data + seg.rd + n, seg.data + seg.rd, pos);
+                seg.rd += n;
+            } else {
+                memmove(begin, begin + n, after);
+                seg.wr -= n;
+            }
+            i++;
+        }
+        len -= n;
+        pos = 0;
+    }
+}
+
 // 预留区域操作
 void Buffer::prepend(const void* data, size_t len) {
+    checkOwner_();
     if (len > prependableBytes()) {
-        std::cout << "len > prependableBytes()" << std::endl;
-        return;
+        Segment seg = acquire_(len);
+        seg.rd = seg.wr = seg.cap;  // 数据放在段的末尾，和后面的段接上
+        m_segs.insert(m_segs.begin(), seg);
     }
-    m_readPos -= len;  // 先移动读取指针，然后再copy过去
-    const char* d = static_cast<const char*>(data);
-    std::copy(d, d + len, m_buffer.begin() + m_readPos);
+    Segment& front = m_segs.front();
+    front.rd -= len;
+    memcpy(front.data + front.rd, data, len);
+    m_readable += len;
 }
 
 // 数据扩展操作
@@ -74,57 +181,192 @@ void Buffer::ensureWriteableBytes(size_t len) {
         makeSpace(len);
     }
 }
+
 void Buffer::makeSpace(size_t len) {
-    if (writeableBytes() + prependableBytes() < len) {
-        m_buffer.resize(m_writePos + len);
+    checkOwner_();
+    if (!m_segs.empty() && m_segs.back().rd == m_segs.back().wr) {
+        // 最后一个段是空的：够大就从头用，不够就换掉
+        Segment& back = m_segs.back();
+        if (back.cap >= len) {
+            back.rd = back.wr = 0;
+            return;
+        }
+        release_(back);
+        m_segs.pop_back();
+    }
+    m_segs.push_back(acquire_(nextSize_(len)));
+}
+
+void Buffer::shrink() {
+    checkOwner_();
+    while (!m_segs.empty() && m_segs.back().rd == m_segs.back().wr) {
+        release_(m_segs.back());
+        m_segs.pop_back();
+    }
+    if (m_segs.empty()) {
+        m_readable = 0;
+    }
+}
+
+// 把前 len 个字节合并到第一个段里：第一个段放得下就把后面段的数据接到它后面，否则换一个够大的段
+void Buffer::linearize_(size_t len) const {
+    size_t need = std::min(len, m_readable);
+    if (need == 0 || m_segs.front().wr - m_segs.front().rd >= need) {
+        return;
+    }
+    Segment dst;
+    size_t from;  // 从哪个段开始往 dst 里拷
+    if (m_segs.front().cap >= need) {
+        dst = m_segs.front();
+        size_t have = dst.wr - dst.rd;
+        if (dst.cap - dst.rd < need) {
+            memmove(dst.data, dst.data + dst.rd, have);
+            dst.rd = 0;
+            dst.wr = have;
+        }
+        from = 1;
     } else {
-        size_t readable = readableBytes();
-        std::copy(m_buffer.begin() + m_readPos, m_buffer.begin() + m_writePos, m_buffer.begin());
-        m_readPos = 0;
-        m_writePos = m_readPos + readable;
+        dst = acquire_(need);
+        from = 0;
+    }
+    size_t i = from;
+    while (dst.wr - dst.rd < need) {
+        Segment& seg = m_segs[i];
+        size_t n = std::min(need - (dst.wr - dst.rd), seg.wr - seg.rd);
+        memcpy(dst.data + dst.wr, seg.data + seg.rd, n);
+        dst.wr += n;
+        seg.rd += n;
+        if (seg.rd == seg.wr) {
+            release_(seg);
+            i++;
+        }
+    }
+    m_segs.erase(m_segs.begin() + from, m_segs.begin() + i);
+    if (from == 0) {
+        m_segs.insert(m_segs.begin(), dst);
+    } else {
+        m_segs.front() = dst;
     }
 }
 
 // 底层数据访问
 const char* Buffer::peek() const {
-    return &m_buffer[m_readPos];
+    return peekContiguous(m_readable);
+}
+
+const char* Buffer::peekContiguous(size_t len) const {
+    checkOwner_();
+    linearize_(len);
+    return m_segs.empty() ? EMPTY : m_segs.front().data + m_segs.front().rd;
+}
+
+const char* Buffer::peekAt(size_t pos, size_t* len) const {
+    checkOwner_();
+    for (const Segment& seg : m_segs) {
+        size_t avail = seg.wr - seg.rd;
+        if (pos < avail) {
+            *len = avail - pos;
+            return seg.data + seg.rd + pos;
+        }
+        pos -= avail;
+    }
+    *len = 0;
+    return EMPTY;
+}
+
+void Buffer::readableIov(size_t pos, size_t len, std::vector<struct iovec>& iov) const {
+    checkOwner_();
+    for (const Segment& seg : m_segs) {
+        if (len == 0) {
+            break;
+        }
+        size_t avail = seg.wr - seg.rd;
+        if (pos >= avail) {
+            pos -= avail;
+            continue;
+        }
+        size_t n = std::min(len, avail - pos);
+        char* p = seg.data + seg.rd + pos;
+        if (!iov.empty() && static_cast<char*>(iov.back().iov_base) + iov.back().iov_len == p) {
+            iov.back().iov_len += n;
+        } else {
+            iov.push_back({p, n});
+        }
+        len -= n;
+        pos = 0;
+    }
 }
 
 char* Buffer::beginWrite() {
-    return &m_buffer[m_writePos];
+    checkOwner_();
+    if (m_segs.empty()) {
+        m_segs.push_back(acquire_(FIRST_SEGMENT));
+    }
+    return m_segs.back().data + m_segs.back().wr;
 }
 
 void Buffer::hasWritten(size_t len) {
-    m_writePos += len;
+    checkOwner_();
+    assert(len <= writeableBytes());
+    m_segs.back().wr += len;
+    m_readable += len;
 }
 
 // fd操作
+// 先读进最后一个段剩下的空间，再读进几个新段，没用上的新段还回池；数据直接落在段里，不经过栈上中转
 ssize_t Buffer::readFd(int fd, int* saveErrno) {
-    char stackbuf[65536];
-    struct iovec vec[2];
-    const size_t writable = writeableBytes();
-    vec[0].iov_base = beginWrite();
-    vec[0].iov_len = writable;
-    vec[1].iov_base = stackbuf;
-    vec[1].iov_len = sizeof(stackbuf);
-    const ssize_t n = readv(fd, vec, 2); //  n为从fd读取的字节数
+    checkOwner_();
+    struct iovec vec[READ_SEGMENTS + 1];
+    Segment fresh[READ_SEGMENTS];
+    int cnt = 0;
+    const size_t tail = writeableBytes();
+    if (tail > 0) {
+        vec[cnt++] = {beginWrite(), tail};
+    }
+    for (int i = 0; i < READ_SEGMENTS; i++) {
+        fresh[i] = acquire_(READ_SIZE[i]);
+        vec[cnt++] = {fresh[i].data, fresh[i].cap};
+    }
+    const ssize_t n = readv(fd, vec, cnt); //  n为从fd读取的字节数
     if (n < 0) {
         *saveErrno = errno;     // 返回负值，读取错误
-    } else if (static_cast<size_t>(n) <= writable) {
-        m_writePos += n;   // 读取成功，移动写入指针
-    } else {
-        m_writePos = m_buffer.size();  // 已经写满
-        append(stackbuf, n - writable); // 将剩余数据写入,这里会扩容
+    }
+    size_t left = n > 0 ? n : 0;
+    size_t k = std::min(left, tail);
+    if (k > 0) {
+        hasWritten(k);
+        left -= k;
+    }
+    for (int i = 0; i < READ_SEGMENTS; i++) {
+        if (left == 0) {
+            release_(fresh[i]);
+            continue;
+        }
+        fresh[i].wr = std::min(left, fresh[i].cap);
+        left -= fresh[i].wr;
+        m_readable += fresh[i].wr;
+        m_segs.push_back(fresh[i]);
     }
     return n;
 }
 
 ssize_t Buffer::writeFd(int fd, int* saveErrno) {
-    size_t readSize = readableBytes();
-    ssize_t n = write(fd, peek(), readSize);  // 从缓冲区写数据到fd
+    checkOwner_();
+    struct iovec vec[16];
+    int cnt = 0;
+    for (const Segment& seg : m_segs) {
+        if (cnt == 16) {
+            break;
+        }
+        if (seg.wr > seg.rd) {
+            vec[cnt++] = {seg.data + seg.rd, seg.wr - seg.rd};
+        }
+    }
+    ssize_t n = writev(fd, vec, cnt);  // 从缓冲区写数据到fd
     if (n < 0) {
         *saveErrno = errno;
+        return n;
     }
-    m_readPos += n;  // 移动读取指针
+    retrieve(n);  // 移动读取指针
     return n;
-}
\ No newline at end of file
+}
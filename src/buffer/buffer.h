@@ -3,53 +3,117 @@
 // buffer模块的头文件
 #include <iostream>
 #include <vector>
-#include <atomic>
+#include <string>
+#include <string_view>
 #include <unistd.h> // 包含系统调用的头文件
 #include <sys/uio.h>  // 包含readv和writev函数的头文件
+#include <assert.h>
+#include "bufferpool.h"
+#ifdef BUFFER_OWNER_CHECK
+#include <thread>
+#endif
 
-
+// 缓冲区由一串段组成，段从 BufferPool 里按档借，用完还回去；缓冲区空了就一个段都不占。
+// 第一个段很小，之后每接一个段大一档，只有一个小请求/响应头的连接不会占着大块内存。
+// 写满了就接一个新段，已有的数据从不搬家、不重新分配；readFd 用 readv 直接读进空闲的段，
+// writeFd 用 writev 直接从段链发出去，readableIov 把任意一段可读数据转成 iovec 交给 sendmsg。
+// 需要连续内存的地方（peek、peekContiguous）才把前面的数据合并到一个段里，只拷贝要求的那么多。
+//
+// 线程约定：一个 Buffer 同一时刻只属于一个线程，所以读写位置都是普通变量，没有原子操作也没有锁。
+// 要换线程（连接从 reactor 交给线程池，或者用锁保护的共享缓冲区）时，当前线程用完后调用 handoff()，
+// 之后第一个访问它的线程成为新的所有者，交接本身的同步（锁、任务队列、epoll 重新注册）由调用方保证。
+// 用 -DBUFFER_OWNER_CHECK 编译时会检查：不是所有者的线程访问就断言失败。默认不开，Makefile 的 -D__DEBUG 不会打开它，
+// 这个检查每次 append/peek/retrieve 都要取线程 id，查线程问题时再加到 CFLAGS 里。
 class Buffer {
 
 public:
+    static constexpr size_t FIRST_SEGMENT = 1024;  // 第一次 append 接的段
+    static constexpr size_t MAX_SEGMENT = 64 * 1024;  // append 接的段最大到这一档
+    static constexpr int READ_SEGMENTS = 3;
+    static constexpr size_t READ_SIZE[READ_SEGMENTS] = {4096, 16384, 65536};  // readFd 每次备好的新段，小请求只占 4K
+
     // 构造函数和析构函数
-    Buffer(size_t buffersize = 1024);
+    Buffer();  // 不分配内存，第一次写入时才从池里借
     ~Buffer();
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
 
     // 读写指针操作
-    size_t writeableBytes() const;  // 返回可写字节数
+    size_t writeableBytes() const;  // 返回最后一个段里连续可写的字节数
     size_t readableBytes() const;  // 返回可读字节数
-    size_t prependableBytes() const;  // 返回预留字节数
+    size_t prependableBytes() const;  // 返回第一个段前面的预留字节数
+    size_t capacity() const { return m_capacity; }  // 所有段的大小之和，就是这个缓冲区现在占的内存
 
     // 写入数据函数
-    void append(const std::string& str);  // 写入字符串，缓存区不够大会自动扩容
-    void append(const char* data, size_t len);  // 写入字符数组，如果缓存区不够大，会自动扩容，len为写入长度
+    void append(std::string_view str);  // 写入字符串，当前段写满了接新段；字符串常量也不会构造临时的 std::string
+    void append(const char* data, size_t len);  // 写入字符数组，len为写入长度
 
     // 读取数据函数
-    void retrieve(size_t len);  // 读取len长度的数据，只移动读取指针
-    void retrieveUntil(const char* end);  // 读取到end位置，只移动读取指针
-    void retrieveAll();  // 读取所有数据，清空缓存区，读写指针归零
+    void retrieve(size_t len);  // 丢掉前 len 个字节，读完的段还给池
+    void retrieveUntil(const char* end);  // 读取到end位置，end 要在 peek() 返回的连续区域里
+    void retrieveAll();  // 清空缓冲区，所有段还给池
     std::string retrieveToStr(size_t len);  // 读取len长度的数据，返回字符串,并移动读取指针
     std::string retrieveAllToStr();  // 读取所有数据，返回字符串，并清空缓存区
+    void erase(size_t pos, size_t len);  // 删除可读区域中从 pos 开始的 len 个字节，整段的直接摘掉，只在段内移动数据
 
     // 预留区域操作
-    void prepend(const void* data, size_t len);  // 将数据插入到缓冲区的预留区域prependable区域
+    void prepend(const void* data, size_t len);  // 插到可读数据前面，第一个段前面放不下就在前面接一个段
 
     // 数据扩展操作
-    void ensureWriteableBytes(size_t len);  // 确保缓冲区有足够的空间写入len长度的数据
-    void makeSpace(size_t len);  // 扩容函数
+    void ensureWriteableBytes(size_t len);  // 确保最后一个段有 len 字节连续可写的空间，已有数据不动
+    void makeSpace(size_t len);  // 接一个至少 len 字节的新段
+    void shrink();  // 还掉没有数据的段（ensureWriteableBytes 备好但没写的），连接空闲时调用
 
     // 底层数据访问
-    const char* peek() const;  // 返回读取指针位置，目的是读取数据
-    char* beginWrite() ;  // 返回写入指针位置，目的是写入数据
+    const char* peek() const;  // 返回可读数据的开头，所有可读数据保证连续（必要时合并）
+    const char* peekContiguous(size_t len) const;  // 只保证前 min(len, 可读) 个字节连续，返回开头
+    const char* peekAt(size_t pos, size_t* len) const;  // 从可读区域的 pos 开始、在同一个段里连续的一块，*len 返回长度
+    // 可读区域 [pos, pos + len) 按段转成 iovec 追加到 iov 后面，和最后一个 iovec 相连的直接合并
+    void readableIov(size_t pos, size_t len, std::vector<struct iovec>& iov) const;
+    char* beginWrite();  // 返回写入指针位置，目的是写入数据
     void hasWritten(size_t len);  // 移动写入指针
 
     // fd操作
     ssize_t readFd(int fd, int* saveErrno);  // 从fd中读取数据到缓冲区
     ssize_t writeFd(int fd, int* saveErrno);  // 从缓冲区写数据到fd
 
+    // 所有者线程交出这个缓冲区，下一个访问的线程成为新的所有者
+    void handoff() {
+#ifdef BUFFER_OWNER_CHECK
+        m_owner = std::thread::id();
+#endif
+    }
+
 private:
-    std::vector<char> m_buffer;  // 成员变量，使用m_作为前缀
-    std::atomic<size_t> m_readPos;  // 读取位置, 使用原子变量保证线程安全，且使用size_t类型，无符号整型
-    std::atomic<size_t> m_writePos;  // 写入位置
+    struct Segment {
+        char* data;
+        size_t cap;  // BufferPool 给的实际大小
+        size_t rd;  // [rd, wr) 是可读数据
+        size_t wr;
+    };
+    Segment acquire_(size_t len) const;  // 会改 m_capacity，peek() 合并段时也要用
+    void release_(Segment& seg) const;
+    size_t nextSize_(size_t len) const;  // append 接新段时要多大
+    void linearize_(size_t len) const;
+    void clear_();  // 所有段还给池
+
+#ifdef BUFFER_OWNER_CHECK
+    // 没有所有者时当前线程成为所有者，否则必须是所有者
+    void checkOwner_() const {
+        std::thread::id self = std::this_thread::get_id();
+        if (m_owner == std::thread::id()) {
+            m_owner = self;
+        }
+        assert(m_owner == self);  // 别的线程还在用，换线程之前要先 handoff()
+    }
+    mutable std::thread::id m_owner;
+#else
+    void checkOwner_() const {}
+#endif
+
+    // peek() 合并段之后内容不变，只是换了存放方式，所以 const 函数里也可以改
+    mutable std::vector<Segment> m_segs;  // 成员变量，使用m_作为前缀
+    size_t m_readable;  // 所有段的可读字节数之和
+    mutable size_t m_capacity;  // 所有段的大小之和
 };
-#endif // BUFFER_H
\ No newline at end of file
+#endif // BUFFER_H
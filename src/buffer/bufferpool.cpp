@@ -0,0 +1,132 @@
+#include "bufferpool.h"
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+
+namespace {
+
+struct LocalPool;
+
+// 所有线程的池，读统计的时候遍历；线程退出时把借出去的字节数记到 s_retiredLive 里
+std::mutex s_registryMutex;
+std::vector<LocalPool*> s_registry;
+int64_t s_retiredLive = 0;
+std::atomic<uint64_t> s_trimmed(0);
+
+// 线程退出时池先析构，之后才析构的 Buffer（比如静态对象里的）直接 delete
+thread_local bool t_poolDead = false;
+
+struct LocalPool {
+    std::vector<char*> free[BufferPool::CLASSES];
+    // 只有本线程写，别的线程读统计，所以用 relaxed 的原子变量，不会有争用
+    std::atomic<int64_t> pooled;
+    std::atomic<int64_t> live;  // 在别的线程归还的块会让这个值变成负数，加起来才对
+
+    LocalPool() : pooled(0), live(0) {
+        std::lock_guard<std::mutex> locker(s_registryMutex);
+        s_registry.push_back(this);
+    }
+    ~LocalPool() {
+        for (int c = 0; c < BufferPool::CLASSES; c++) {
+            for (char* p : free[c]) {
+                delete[] p;
+            }
+        }
+        std::lock_guard<std::mutex> locker(s_registryMutex);
+        s_retiredLive += live.load(std::memory_order_relaxed);
+        s_registry.erase(std::find(s_registry.begin(), s_registry.end(), this));
+        t_poolDead = true;
+    }
+    void add(std::atomic<int64_t>& counter, int64_t n) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+};
+
+thread_local LocalPool t_pool;
+
+} // namespace
+
+int BufferPool::classOf_(size_t size) {
+    for (int c = 0; c < CLASSES; c++) {
+        if (size <= CLASS_SIZE[c]) {
+            return c;
+        }
+    }
+    return -1;
+}
+
+char* BufferPool::alloc(size_t size, size_t* cap) {
+    int c = classOf_(size);
+    *cap = c < 0 ? size : CLASS_SIZE[c];
+    char* p = nullptr;
+    if (c >= 0 && !t_poolDead && !t_pool.free[c].empty()) {
+        p = t_pool.free[c].back();
+        t_pool.free[c].pop_back();
+        t_pool.add(t_pool.pooled, -(int64_t)*cap);
+    } else {
+        p = new char[*cap];
+    }
+    if (!t_poolDead) {
+        t_pool.add(t_pool.live, *cap);
+    }
+    return p;
+}
+
+void BufferPool::free(char* p, size_t cap) {
+    if (t_poolDead) {
+        delete[] p;
+        return;
+    }
+    t_pool.add(t_pool.live, -(int64_t)cap);
+    int c = classOf_(cap);
+    if (c >= 0 && CLASS_SIZE[c] == cap && t_pool.free[c].size() * cap < MAX_FREE_BYTES) {
+        t_pool.free[c].push_back(p);
+        t_pool.add(t_pool.pooled, cap);
+    } else {
+        delete[] p;
+    }
+}
+
+void BufferPool::trim() {
+    if (t_poolDead) {
+        return;
+    }
+    for (int c = 0; c < CLASSES; c++) {
+        std::vector<char*>& list = t_pool.free[c];
+        size_t keep = TRIM_KEEP_BYTES / CLASS_SIZE[c];
+        if (list.size() <= keep) {
+            continue;
+        }
+        size_t bytes = (list.size() - keep) * CLASS_SIZE[c];
+        for (size_t i = keep; i < list.size(); i++) {
+            delete[] list[i];
+        }
+        list.resize(keep);
+        list.shrink_to_fit();
+        t_pool.add(t_pool.pooled, -(int64_t)bytes);
+        s_trimmed.fetch_add(bytes, std::memory_order_relaxed);
+    }
+}
+
+size_t BufferPool::pooledBytes() {
+    std::lock_guard<std::mutex> locker(s_registryMutex);
+    int64_t sum = 0;
+    for (LocalPool* pool : s_registry) {
+        sum += pool->pooled.load(std::memory_order_relaxed);
+    }
+    return sum > 0 ? sum : 0;
+}
+
+size_t BufferPool::liveBytes() {
+    std::lock_guard<std::mutex> locker(s_registryMutex);
+    int64_t sum = s_retiredLive;
+    for (LocalPool* pool : s_registry) {
+        sum += pool->live.load(std::memory_order_relaxed);
+    }
+    return sum > 0 ? sum : 0;
+}
+
+uint64_t BufferPool::trimmedBytes() {
+    return s_trimmed;
+}
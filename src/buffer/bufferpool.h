@@ -0,0 +1,34 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Buffer 的段从这里借：按大小分几档，每个线程每档一个空闲链表，借还都不加锁。
+// 比最大一档还大的直接 new/delete，不进池。
+// 每档空闲的最多留 MAX_FREE_BYTES，reactor 空闲时调用 trim() 再还掉一部分，突发过后内存能降下来。
+// 统计（池里空闲的字节、借出去的字节）每个线程各记各的，读的时候再加起来。
+class BufferPool {
+public:
+    static constexpr int CLASSES = 4;
+    static constexpr size_t CLASS_SIZE[CLASSES] = {1024, 4096, 16384, 65536};
+    static constexpr size_t MAX_FREE_BYTES = 1 << 20;  // 每个线程每档最多缓存多少空闲字节
+    static constexpr size_t TRIM_KEEP_BYTES = 128 << 10;  // trim 之后每档留多少
+
+    // 借一块至少 size 字节的内存，*cap 返回实际大小（所在档的大小）
+    static char* alloc(size_t size, size_t* cap);
+    // cap 必须是 alloc 返回的那个
+    static void free(char* p, size_t cap);
+    // 把当前线程池里多余的空闲块还给系统
+    static void trim();
+
+    // 统计，所有线程加起来
+    static size_t pooledBytes();  // 池里空闲着的
+    static size_t liveBytes();  // 借出去还在用的
+    static uint64_t trimmedBytes();  // trim 累计还给系统的
+
+private:
+    static int classOf_(size_t size);  // 没有合适的档返回 -1
+};
+
+#endif // BUFFERPOOL_H
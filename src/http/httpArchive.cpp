@@ -0,0 +1,187 @@
+#include "httpArchive.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <chrono>
+
+static const size_t HUGE_PAGE = 2 << 20;
+
+HttpArchive* HttpArchive::instance() {
+    static HttpArchive archive;
+    return &archive;
+}
+
+HttpArchive::HttpArchive() : m_base(nullptr), m_size(0), m_mapLen(0), m_hugepages(false),
+    m_warmMs(0), m_rssBytes(0), m_hugeBytes(0) {}
+
+HttpArchive::~HttpArchive() {
+    unload_();
+}
+
+void HttpArchive::unload_() {
+    m_files.clear();
+    if (m_base) {
+        munmap(m_base, m_mapLen);
+        m_base = nullptr;
+    }
+    m_size = m_mapLen = 0;
+}
+
+// mmap 只保证 4K 对齐，多要 2M 再把首尾多出来的还回去，整段才能用上大页
+void* HttpArchive::alignedMap_(size_t len) {
+    void* raw = mmap(nullptr, len + HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return raw;
+    }
+    uintptr_t begin = reinterpret_cast<uintptr_t>(raw);
+    uintptr_t aligned = (begin + HUGE_PAGE - 1) & ~(uintptr_t)(HUGE_PAGE - 1);
+    if (aligned > begin) {
+        munmap(raw, aligned - begin);
+    }
+    if (aligned + len < begin + len + HUGE_PAGE) {
+        munmap(reinterpret_cast<void*>(aligned + len), begin + HUGE_PAGE - aligned);
+    }
+    return reinterpret_cast<void*>(aligned);
+}
+
+// 在服务器启动前调用
+bool HttpArchive::load(const std::string& path, bool hugepages) {
+    unload_();
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(Header)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    size_t rssBefore = rss_();
+    size_t hugeBefore = anonHugePages_();
+    auto start = std::chrono::steady_clock::now();
+    m_size = st.st_size;
+    m_hugepages = hugepages;
+    void* base = MAP_FAILED;
+    if (hugepages) {
+        // 文件页不一定能用透明大页，拷一份到 2M 对齐的匿名内存里，读的时候由内核直接分配大页
+        m_mapLen = (m_size + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+        base = alignedMap_(m_mapLen);
+        if (base != MAP_FAILED) {
+            madvise(base, m_mapLen, MADV_HUGEPAGE);
+            size_t done = 0;
+            while (done < m_size) {
+                ssize_t n = pread(fd, static_cast<char*>(base) + done, m_size - done, done);
+                if (n <= 0) {
+                    break;
+                }
+                done += n;
+            }
+            mprotect(base, m_mapLen, PROT_READ);
+            if (done < m_size) {
+                munmap(base, m_mapLen);
+                base = MAP_FAILED;
+            }
+        }
+    } else {
+        // MAP_POPULATE 在映射时就把所有页读进来建好页表，之后访问不会缺页
+        m_mapLen = m_size;
+        base = mmap(nullptr, m_mapLen, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    }
+    close(fd);
+    if (base == MAP_FAILED) {
+        m_size = m_mapLen = 0;
+        return false;
+    }
+    m_base = static_cast<char*>(base);
+    if (!parse_()) {
+        unload_();
+        return false;
+    }
+    m_warmMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    size_t rssAfter = rss_();
+    m_rssBytes = rssAfter > rssBefore ? rssAfter - rssBefore : 0;
+    size_t hugeAfter = anonHugePages_();
+    m_hugeBytes = hugeAfter > hugeBefore ? hugeAfter - hugeBefore : 0;
+    return true;
+}
+
+// 校验每个偏移都在包内，之后查找时不再检查
+bool HttpArchive::parse_() {
+    const Header* h = reinterpret_cast<const Header*>(m_base);
+    if (memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0 || h->version != VERSION || h->size != m_size
+        || h->indexOff + (uint64_t)h->count * sizeof(Entry) > m_size || h->dataOff > m_size) {
+        return false;
+    }
+    auto str = [this](const Ref& r, std::string_view* out) {
+        if ((uint64_t)r.off + r.len > m_size) {
+            return false;
+        }
+        *out = std::string_view(m_base + r.off, r.len);
+        return true;
+    };
+    const Entry* entries = reinterpret_cast<const Entry*>(m_base + h->indexOff);
+    m_files.reserve(h->count);
+    for (uint32_t i = 0; i < h->count; i++) {
+        const Entry& e = entries[i];
+        File file = {};
+        std::string_view path;
+        if (!str(e.path, &path) || !str(e.type, &file.type) || !str(e.lastModified, &file.lastModified)) {
+            return false;
+        }
+        file.mtime = e.mtime;
+        for (int v = 0; v < VARIANTS; v++) {
+            const Blob& b = e.variants[v];
+            if (b.etag.len == 0) {
+                continue;
+            }
+            if (b.off > m_size || b.len > m_size - b.off || !str(b.etag, &file.variants[v].etag)) {
+                return false;
+            }
+            file.variants[v].data = m_base + b.off;
+            file.variants[v].len = b.len;
+            file.encodings |= v;  // IDENTITY 是 0，不占位
+        }
+        if (file.variants[0].etag.empty()) {
+            return false;  // 原始内容一定要有
+        }
+        m_files.emplace(path, file);
+    }
+    return true;
+}
+
+const HttpArchive::File* HttpArchive::find(std::string_view path) const {
+    auto it = m_files.find(path);
+    return it == m_files.end() ? nullptr : &it->second;
+}
+
+// /proc/self/statm 第二列是常驻页数
+size_t HttpArchive::rss_() {
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if (!fp) {
+        return 0;
+    }
+    unsigned long size = 0, resident = 0;
+    if (fscanf(fp, "%lu %lu", &size, &resident) != 2) {
+        resident = 0;
+    }
+    fclose(fp);
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+size_t HttpArchive::anonHugePages_() {
+    FILE* fp = fopen("/proc/self/smaps_rollup", "r");
+    if (!fp) {
+        return 0;
+    }
+    char line[256];
+    unsigned long kb = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "AnonHugePages: %lu kB", &kb) == 1) {
+            break;
+        }
+    }
+    fclose(fp);
+    return kb << 10;
+}
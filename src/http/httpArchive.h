@@ -0,0 +1,99 @@
+#ifndef HTTPARCHIVE_H
+#define HTTPARCHIVE_H
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <stdint.h>
+#include <time.h>
+
+// 静态资源包：packassets 把整个 resources/ 打成一个带索引的文件，启动时整块读进内存，
+// 之后每个请求都直接从内存发，不 stat、不 open，也不会缺页。
+// 每个文件带着 MIME 类型、ETag、Last-Modified 和预先压缩好的 gzip/br 版本。
+//
+// 文件格式（本机字节序，只给同一台机器/同一种架构用）：
+//   Header | Entry[count] | 字符串区（路径、类型、ETag、Last-Modified）| 数据区（从 4K 对齐处开始）
+// 所有偏移都相对文件开头
+class HttpArchive {
+public:
+    static const uint32_t VERSION = 1;
+    static const int VARIANTS = 3;  // 下标是 HttpEncoding::ENCODING
+    static const size_t DATA_ALIGN = 4096;
+
+    struct Ref {
+        uint32_t off;
+        uint32_t len;
+    };
+    struct Blob {
+        uint64_t off;
+        uint64_t len;
+        Ref etag;  // etag.len 为 0 表示没有这个编码的版本
+    };
+    struct Entry {
+        Ref path;  // 以 / 开头，和请求路径一致
+        Ref type;
+        Ref lastModified;
+        int64_t mtime;
+        Blob variants[VARIANTS];
+    };
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t count;
+        uint64_t indexOff;
+        uint64_t dataOff;
+        uint64_t size;  // 整个文件的大小
+    };
+    static constexpr char MAGIC[8] = {'W', 'S', 'P', 'A', 'C', 'K', '0', '1'};
+
+    // 加载之后的视图，都指向包所在的内存
+    struct Content {
+        const char* data;
+        size_t len;
+        std::string_view etag;
+    };
+    struct File {
+        std::string_view type;
+        std::string_view lastModified;
+        time_t mtime;
+        int encodings;  // 有哪些压缩版本，HttpEncoding::ENCODING 的位
+        Content variants[VARIANTS];
+    };
+
+    static HttpArchive* instance();
+
+    // hugepages: 读进按 2M 对齐、开了 MADV_HUGEPAGE 的匿名内存，否则 MAP_POPULATE 映射文件
+    bool load(const std::string& path, bool hugepages);
+    bool loaded() const { return m_base != nullptr; }
+    // 没有返回 nullptr
+    const File* find(std::string_view path) const;
+
+    // 加载统计
+    size_t files() const { return m_files.size(); }
+    size_t size() const { return m_size; }
+    double warmMs() const { return m_warmMs; }
+    size_t rssBytes() const { return m_rssBytes; }  // 加载前后进程 RSS 的差
+    size_t hugeBytes() const { return m_hugeBytes; }  // 实际落在透明大页上的字节数
+    bool hugepages() const { return m_hugepages; }
+
+private:
+    HttpArchive();
+    ~HttpArchive();
+
+    bool parse_();
+    void unload_();
+    static void* alignedMap_(size_t len);
+    static size_t rss_();
+    static size_t anonHugePages_();
+
+    char* m_base;
+    size_t m_size;
+    size_t m_mapLen;
+    bool m_hugepages;
+    double m_warmMs;
+    size_t m_rssBytes;
+    size_t m_hugeBytes;
+    std::unordered_map<std::string_view, File> m_files;
+};
+
+#endif // HTTPARCHIVE_H
@@ -0,0 +1,149 @@
+#include "httpCache.h"
+
+HttpCache* HttpCache::instance() {
+    static HttpCache cache;
+    return &cache;
+}
+
+HttpCache::HttpCache() : m_capacity(0), m_shardCapacity(0), m_maxObjectSize(0),
+    m_hits(0), m_misses(0), m_evictions(0), m_bytes(0), m_entries(0), m_epoch(0) {}
+
+// 在服务器启动前调用，之后分片数不再变化
+void HttpCache::init(size_t capacity, size_t maxObjectSize, int shardNum) {
+    assert(shardNum > 0);
+    clear();
+    m_shards.clear();
+    for (int i = 0; i < shardNum; i++) {
+        m_shards.emplace_back(new Shard());
+    }
+    m_capacity = capacity;
+    m_shardCapacity = capacity / shardNum;
+    m_maxObjectSize = std::min(maxObjectSize, m_shardCapacity);  // 一个分片都放不下的不缓存
+}
+
+HttpCache::Shard& HttpCache::shard_(const std::string& path) {
+    return *m_shards[std::hash<std::string>()(path) % m_shards.size()];
+}
+
+HttpCacheEntryPtr HttpCache::get(const std::string& path, int variant) {
+    assert(variant >= 0 && variant < MAX_VARIANT);
+    if (!enabled()) {
+        return nullptr;
+    }
+    Shard& s = shard_(path);
+    std::lock_guard<std::mutex> locker(s.mtx);
+    auto it = s.index.find(path);
+    if (it == s.index.end() || !it->second->variants[variant]) {
+        m_misses++;
+        return nullptr;
+    }
+    s.lru.splice(s.lru.begin(), s.lru, it->second);  // 移到最前面，不用重新分配节点
+    m_hits++;
+    return it->second->variants[variant];
+}
+
+void HttpCache::put(const std::string& path, HttpCacheEntryPtr entry, int variant, uint64_t epoch) {
+    assert(variant >= 0 && variant < MAX_VARIANT);
+    size_t size = entry->bytes();
+    if (!enabled() || size > m_maxObjectSize) {
+        return;
+    }
+    Shard& s = shard_(path);
+    std::lock_guard<std::mutex> locker(s.mtx);
+    // erase 先加 epoch 再拿锁，这里在锁里检查，旧内容要么放不进来，要么放进来之后被 erase 删掉
+    if (epoch != m_epoch) {
+        return;
+    }
+    auto it = s.index.find(path);
+    if (it == s.index.end()) {
+        s.lru.emplace_front();
+        s.lru.front().path = path;
+        it = s.index.emplace(path, s.lru.begin()).first;
+    } else {
+        s.lru.splice(s.lru.begin(), s.lru, it->second);
+    }
+    Node& node = *it->second;
+    // 别的线程同时未命中，已经放进来了，用新的替换
+    if (node.variants[variant]) {
+        node.bytes -= node.variants[variant]->bytes();
+        s.bytes -= node.variants[variant]->bytes();
+        m_bytes -= node.variants[variant]->bytes();
+        m_entries--;
+    }
+    node.variants[variant] = entry;
+    node.bytes += size;
+    s.bytes += size;
+    m_bytes += size;
+    m_entries++;
+    // 从尾部淘汰最久没用的，直到放得下
+    while (s.bytes > m_shardCapacity && !s.lru.empty()) {
+        for (auto& v : s.lru.back().variants) {
+            m_evictions += v ? 1 : 0;
+        }
+        unlink_(s, std::prev(s.lru.end()));
+    }
+}
+
+bool HttpCache::beginFill(const std::string& path, int variant) {
+    assert(variant >= 0 && variant < MAX_VARIANT);
+    Shard& s = shard_(path);
+    std::lock_guard<std::mutex> locker(s.mtx);
+    int& bits = s.filling[path];
+    if (bits & (1 << variant)) {
+        return false;
+    }
+    bits |= 1 << variant;
+    return true;
+}
+
+void HttpCache::endFill(const std::string& path, int variant) {
+    Shard& s = shard_(path);
+    std::lock_guard<std::mutex> locker(s.mtx);
+    auto it = s.filling.find(path);
+    if (it == s.filling.end()) {
+        return;
+    }
+    it->second &= ~(1 << variant);
+    if (it->second == 0) {
+        s.filling.erase(it);
+    }
+}
+
+void HttpCache::unlink_(Shard& s, std::list<Node>::iterator it) {
+    for (auto& v : it->variants) {
+        m_entries -= v ? 1 : 0;
+    }
+    s.bytes -= it->bytes;
+    m_bytes -= it->bytes;
+    s.index.erase(it->path);
+    s.lru.erase(it);
+}
+
+void HttpCache::erase(const std::string& path) {
+    if (!enabled()) {
+        return;
+    }
+    m_epoch++;
+    Shard& s = shard_(path);
+    std::lock_guard<std::mutex> locker(s.mtx);
+    auto it = s.index.find(path);
+    if (it != s.index.end()) {
+        unlink_(s, it->second);
+    }
+}
+
+void HttpCache::clear() {
+    m_epoch++;
+    for (auto& s : m_shards) {
+        std::lock_guard<std::mutex> locker(s->mtx);
+        for (auto& node : s->lru) {
+            for (auto& v : node.variants) {
+                m_entries -= v ? 1 : 0;
+            }
+        }
+        m_bytes -= s->bytes;
+        s->bytes = 0;
+        s->index.clear();
+        s->lru.clear();
+    }
+}
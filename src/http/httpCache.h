@@ -0,0 +1,99 @@
+#ifndef HTTPCACHE_H
+#define HTTPCACHE_H
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <assert.h>
+#include <time.h>
+
+// 缓存的一个静态响应：序列化好的状态行+响应头，以及文件内容
+// 发送时直接把 header/body 放进 writev 的 iovec，不再 stat/open/mmap，也不拼字符串
+struct HttpCacheEntry {
+    std::string header;  // 状态行、Date、Connection 之后的响应头，带结尾的空行
+    std::string body;
+    std::string etag;  // 条件请求命中缓存时直接用来判断 304
+    std::string lastModified;
+    time_t mtime = 0;
+    int encoding = 0;  // 实际的内容编码，HttpEncoding::ENCODING
+    size_t bytes() const { return header.size() + body.size(); }
+};
+typedef std::shared_ptr<const HttpCacheEntry> HttpCacheEntryPtr;
+
+// 静态响应缓存，按路径分片的 LRU，每个分片一把锁，容量按字节算
+// 同一个路径可以有几个变体（不同的内容编码），放在一个节点里一起淘汰，查找时不用拼 key
+// 条目用 shared_ptr 持有，被淘汰时还在发送的连接不受影响
+// 文件变化由 FileWatcher 调 erase/clear 通知，命中时不再检查文件
+class HttpCache {
+public:
+    static const int MAX_VARIANT = 4;
+
+    static HttpCache* instance();
+
+    // capacity: 总字节数上限，0 表示关闭缓存；maxObjectSize: 单个响应的上限；shardNum: 分片数
+    void init(size_t capacity, size_t maxObjectSize, int shardNum = 16);
+
+    // 没有返回空
+    HttpCacheEntryPtr get(const std::string& path, int variant = 0);
+    // epoch 是开始读文件之前的 epoch()，这之后有过失效说明读到的可能是旧文件，不放进来
+    void put(const std::string& path, HttpCacheEntryPtr entry, int variant, uint64_t epoch);
+    // 生成一个变体（压缩）之前调用，同一个路径的同一个变体同时只有一个线程能拿到，
+    // 拿不到返回 false，调用方先发别的变体，不要重复生成；拿到的生成完（不管成功没有）调用 endFill
+    bool beginFill(const std::string& path, int variant);
+    void endFill(const std::string& path, int variant);
+    // 文件变了，删掉这个路径的所有变体
+    void erase(const std::string& path);
+    void clear();
+    // 每次 erase/clear 加一
+    uint64_t epoch() const { return m_epoch; }
+
+    bool enabled() const { return m_capacity > 0; }
+    size_t capacity() const { return m_capacity; }
+    size_t maxObjectSize() const { return m_maxObjectSize; }
+
+    // 统计
+    uint64_t hits() const { return m_hits; }
+    uint64_t misses() const { return m_misses; }
+    uint64_t evictions() const { return m_evictions; }
+    size_t bytes() const { return m_bytes; }
+    size_t entries() const { return m_entries; }
+
+private:
+    HttpCache();
+    ~HttpCache() = default;
+
+    struct Node {
+        std::string path;
+        HttpCacheEntryPtr variants[MAX_VARIANT];
+        size_t bytes = 0;
+    };
+    struct Shard {
+        std::mutex mtx;
+        std::list<Node> lru;  // 头部是最近用过的
+        std::unordered_map<std::string, std::list<Node>::iterator> index;
+        std::unordered_map<std::string, int> filling;  // 正在生成的变体，按位记
+        size_t bytes = 0;
+    };
+    Shard& shard_(const std::string& path);
+    void unlink_(Shard& s, std::list<Node>::iterator it);  // 持有分片锁时调用
+
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    size_t m_capacity;
+    size_t m_shardCapacity;
+    size_t m_maxObjectSize;
+
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_misses;
+    std::atomic<uint64_t> m_evictions;
+    std::atomic<size_t> m_bytes;
+    std::atomic<size_t> m_entries;
+    std::atomic<uint64_t> m_epoch;
+};
+
+#endif // HTTPCACHE_H
@@ -3,15 +3,36 @@
 // 声明静态成员变量
 const char* HttpConn::srcDir;
 std::atomic<int> HttpConn::userCount;
+std::atomic<uint64_t> HttpConn::sendfileBytes;
+std::atomic<uint64_t> HttpConn::writevBytes;
+size_t HttpConn::writeQuantum = 256 * 1024;
+std::atomic<uint64_t> HttpConn::writeYields;
+int HttpConn::keepAliveRequests = 1000;
+int HttpConn::keepAliveTimeout = 15000;
+std::atomic<uint64_t> HttpConn::connections;
+std::atomic<uint64_t> HttpConn::requests;
+std::atomic<uint64_t> HttpConn::keepAliveCapped;
+std::atomic<uint64_t> HttpConn::idleTimeouts;
+std::atomic<size_t> HttpConn::peakFootprint;
 bool HttpConn::isET; 
 
 HttpConn::HttpConn() {
     m_sockFd = -1;
     m_addr = {0};
     m_isClose = true;
+    m_isKeepAlive = false;
+    m_requests = 0;
+    m_iovIdx = 0;
+    m_fileIdx = 0;
+    m_toWrite = 0;
+    m_respCnt = 0;
+    m_ssl = nullptr;
+    m_tlsReady = false;
+    m_ktlsTx = false;
 }
 
 HttpConn::~HttpConn() {
+    handoff();  // 析构时已经没有别的线程在用了
     httpclose();
 }
 
@@ -23,18 +44,36 @@ void HttpConn::init(int sockFd, const sockaddr_in& addr) {
     m_sockFd = sockFd;
     m_readBuff.retrieveAll();
     m_writeBuff.retrieveAll();
-    m_iovCnt = 0;
+    resetOutput_();
     m_isClose = false;
+    m_isKeepAlive = false;
+    m_requests = 0;
+    connections.fetch_add(1, std::memory_order_relaxed);
+    m_request.init();
+    m_tlsReady = false;
+    m_ktlsTx = false;
+    if(HttpTls::instance()->enabled()) {
+        m_ssl = HttpTls::instance()->newSession(sockFd);  // 失败的话第一次读就会关掉连接
+    }
     LOG_INFO("Client[%d](%s:%d) in, userCount:%d", m_sockFd, getIP(), getPort(), (int)userCount);
 }
 
 void HttpConn::httpclose() {
-    m_response.unmapFile();
+    resetOutput_();
     if(m_isClose == false) {
         m_isClose = true;
         userCount--;
-        close(m_sockFd);
+        if(m_ssl) {
+            if(m_tlsReady) {
+                SSL_shutdown(m_ssl);  // 非阻塞，尽力发出 close_notify，不等对方回应
+            }
+            SSL_free(m_ssl);
+            m_ssl = nullptr;
+        }
         LOG_INFO("Client[%d](%s:%d) quit, UserCount:%d", m_sockFd, getIP(), getPort(), (int)userCount);
+        handoff();
+        // fd 关掉之后可能马上被别的 reactor 复用，在那个线程里 init 这个对象，所以 close 必须是最后一次访问
+        close(m_sockFd);
     }
 }
 
@@ -55,6 +94,9 @@ int HttpConn::getPort() const {
 }
 
 ssize_t HttpConn::read(int* saveErrno) {
+    if(HttpTls::instance()->enabled()) {
+        return readTls_(saveErrno);
+    }
     ssize_t len = -1;
     do {
         len = m_readBuff.readFd(m_sockFd, saveErrno);
@@ -66,58 +108,311 @@ ssize_t HttpConn::read(int* saveErrno) {
     return len;
 }
 
+bool HttpConn::handshake_(int* saveErrno) {
+    int ret = m_ssl ? HttpTls::instance()->handshake(m_ssl) : -1;
+    if(ret > 0) {
+        m_tlsReady = true;
+        m_ktlsTx = HttpTls::ktlsSend(m_ssl);
+        LOG_DEBUG("Client[%d] TLS %s %s, ktls tx:%d", m_sockFd, SSL_get_version(m_ssl),
+                  SSL_get_cipher_name(m_ssl), (int)m_ktlsTx);
+        return true;
+    }
+    // 握手期间服务器只在收到客户端消息之后回一小段，socket 发送缓冲区不会满，WANT_WRITE 也按等数据处理
+    *saveErrno = ret == 0 ? EAGAIN : EPROTO;
+    return false;
+}
+
+// SSL 自己还缓存着解密好的记录，epoll 不会再通知，LT 模式也要读到 WANT_READ 为止
+ssize_t HttpConn::readTls_(int* saveErrno) {
+    if(!m_tlsReady && !handshake_(saveErrno)) {
+        return -1;
+    }
+    ssize_t total = 0;
+    for(;;) {
+        m_readBuff.ensureWriteableBytes(4096);
+        size_t room = std::min<size_t>(m_readBuff.writeableBytes(), INT_MAX);
+        ERR_clear_error();
+        int n = SSL_read(m_ssl, m_readBuff.beginWrite(), (int)room);
+        if(n > 0) {
+            m_readBuff.hasWritten(n);
+            total += n;
+            continue;
+        }
+        int err = SSL_get_error(m_ssl, n);
+        if(err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
+            *saveErrno = EAGAIN;
+        } else if(err == SSL_ERROR_ZERO_RETURN) {
+            *saveErrno = 0;  // 对方发了 close_notify，和 read 返回 0 一样处理
+            return total;
+        } else {
+            *saveErrno = err == SSL_ERROR_SYSCALL && errno ? errno : EPROTO;
+        }
+        return total > 0 ? total : -1;
+    }
+}
+
+// 一次最多发 writeQuantum 字节就返回（还没发完、也没有出错），由调用方重新注册 EPOLLOUT，
+// 大文件、慢客户端不会一直占着 reactor，同一批就绪的其他连接先轮到
 ssize_t HttpConn::write(int* saveErrno){
+    if(m_ssl && !m_ktlsTx) {
+        return writeTls_(saveErrno);
+    }
     ssize_t len = -1;
+    size_t sent = 0;  // 这次可写事件里已经发出的字节数
     do {
-        len = writev(m_sockFd, m_iov, m_iovCnt); // 将数据写到socket
-        if(len <= 0) {
-            *saveErrno = errno;
-            break;
+        struct iovec& cur = m_iov[m_iovIdx];
+        if(cur.iov_base == nullptr) {
+            // 文件段：sendfile 在内核里直接从页缓存拷到 socket，偏移由内核推进，EAGAIN 之后从这里接着发
+            FileSeg& seg = m_files[m_fileIdx];
+            size_t count = cur.iov_len;
+            if(writeQuantum > 0) {
+                count = std::min(count, writeQuantum - sent);
+            }
+            len = sendfile(m_sockFd, seg.fd, &seg.offset, count);
+            if(len <= 0) {
+                *saveErrno = len < 0 ? errno : EIO;  // 返回 0 说明文件被截断了，没法再发
+                break;
+            }
+            sendfileBytes.fetch_add(len, std::memory_order_relaxed);
+            cur.iov_len -= len;
+            if(cur.iov_len == 0) {
+                m_iovIdx++;
+                m_fileIdx++;
+            }
+        } else {
+            // 内存段（响应头、小文件映射、缓存）：连续的一次 sendmsg 发出去，最多 IOV_MAX 段
+            // 后面紧跟文件段时带 MSG_MORE，让响应头和文件开头凑成满的报文一起发
+            size_t end = m_iovIdx;
+            while(end < m_iov.size() && m_iov[end].iov_base != nullptr && end - m_iovIdx < IOV_MAX) {
+                end++;
+            }
+            struct msghdr msg = {};
+            msg.msg_iov = &cur;
+            msg.msg_iovlen = end - m_iovIdx;
+            int flags = MSG_NOSIGNAL | (end < m_iov.size() ? MSG_MORE : 0);
+            len = sendmsg(m_sockFd, &msg, flags); // 将数据写到socket
+            if(len <= 0) {
+                *saveErrno = errno;
+                break;
+            }
+            writevBytes.fetch_add(len, std::memory_order_relaxed);
+            // 跳过已经发完的段，停在发了一半的段上
+            size_t left = len;
+            while(left > 0) {
+                struct iovec& iov = m_iov[m_iovIdx];
+                if(left >= iov.iov_len) {
+                    left -= iov.iov_len;
+                    m_iovIdx++;
+                } else {
+                    iov.iov_base = (uint8_t*)iov.iov_base + left;
+                    iov.iov_len -= left;
+                    left = 0;
+                }
+            }
         }
+        m_toWrite -= len;
+        sent += len;
         // == 0 说明数据已经全部写完
-        if(m_iov[0].iov_len + m_iov[1].iov_len == 0) {
+        if(m_toWrite == 0) {
+            resetOutput_();
             break;
-        } 
-        // 写入的字节大于第一个缓冲区的长度，调整m_iov[1]基地址和长度，清空m_iov[0]
-        else if(static_cast<size_t>(len) > m_iov[0].iov_len) {
-            m_iov[1].iov_base = (uint8_t*)m_iov[1].iov_base + (len - m_iov[0].iov_len);
-            m_iov[1].iov_len -= (len - m_iov[0].iov_len);
-            if(m_iov[0].iov_len) {
-                m_writeBuff.retrieveAll();
-                m_iov[0].iov_len = 0;
+        }
+        if(writeQuantum > 0 && sent >= writeQuantum) {
+            writeYields.fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+    } while(isET || ToWriteBytes() > 10240); // ET模式下，需要一次性将数据写完
+    if(m_ssl) {
+        HttpTls::instance()->addKernelBytes(sent);  // kTLS：上面的 sendmsg/sendfile 由内核加密
+    }
+    return len;
+}
+
+// 没有 kTLS 时的退路：内存段直接 SSL_write，文件段每次 pread 一个记录大小再加密，额度和上面一样
+// SSL_write 返回 WANT_WRITE 之后要用同样的长度重试，这里每次可写事件从 sent = 0 开始，长度算出来是一样的
+ssize_t HttpConn::writeTls_(int* saveErrno) {
+    ssize_t len = -1;
+    size_t sent = 0;
+    char chunk[16384];  // 一个 TLS 记录的最大明文长度
+    while(m_toWrite > 0) {
+        struct iovec& cur = m_iov[m_iovIdx];
+        const char* data = static_cast<const char*>(cur.iov_base);
+        size_t count = cur.iov_len;
+        if(writeQuantum > 0) {
+            count = std::min(count, writeQuantum - sent);
+        }
+        if(data == nullptr) {
+            FileSeg& seg = m_files[m_fileIdx];
+            ssize_t n = pread(seg.fd, chunk, std::min(count, sizeof(chunk)), seg.offset);
+            if(n <= 0) {
+                *saveErrno = n < 0 ? errno : EIO;
+                len = -1;
+                break;
             }
+            data = chunk;
+            count = n;
+        }
+        ERR_clear_error();
+        int n = SSL_write(m_ssl, data, (int)std::min<size_t>(count, INT_MAX));
+        if(n <= 0) {
+            int err = SSL_get_error(m_ssl, n);
+            *saveErrno = err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ ? EAGAIN
+                       : (err == SSL_ERROR_SYSCALL && errno ? errno : EPROTO);
+            len = -1;
+            break;
+        }
+        len = n;
+        HttpTls::instance()->addUserBytes(n);
+        writevBytes.fetch_add(n, std::memory_order_relaxed);  // 文件段也是先读到用户态的
+        if(cur.iov_base == nullptr) {
+            m_files[m_fileIdx].offset += n;
         } else {
-            m_iov[0].iov_base = (uint8_t*)m_iov[0].iov_base + len;
-            m_iov[0].iov_len -= len;
-            m_writeBuff.retrieve(len);
+            cur.iov_base = (uint8_t*)cur.iov_base + n;
         }
-    } while(isET || ToWriteBytes() > 10240); // ET模式下，需要一次性将数据写完
+        cur.iov_len -= n;
+        if(cur.iov_len == 0) {
+            m_fileIdx += cur.iov_base == nullptr;
+            m_iovIdx++;
+        }
+        m_toWrite -= n;
+        sent += n;
+        if(m_toWrite == 0) {
+            resetOutput_();
+            break;
+        }
+        if(writeQuantum > 0 && sent >= writeQuantum) {
+            writeYields.fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+    }
     return len;
 }
 
+void HttpConn::resetOutput_() {
+    for(size_t i = 0; i < m_respCnt; i++) {
+        m_responses[i]->unmapFile();
+    }
+    m_respCnt = 0;
+    m_iov.clear();
+    m_iovIdx = 0;
+    m_files.clear();
+    m_fileIdx = 0;
+    m_toWrite = 0;
+    m_writeBuff.retrieveAll();
+}
+
+// 缓冲区只归一个线程用，换线程只能在这里交接；调用之后当前线程不能再碰这个连接
+void HttpConn::handoff() {
+    m_readBuff.handoff();
+    m_writeBuff.handoff();
+}
+
+// 保持的连接大部分时间在等下一个请求，这时缓冲区已经空了（段都还给了 BufferPool），
+// 再把流水线突发时多建的响应对象、变大的 iovec 数组也还掉，空闲连接就只剩对象本身
+void HttpConn::shrink() {
+    m_readBuff.shrink();
+    m_writeBuff.shrink();
+    if(m_responses.size() > 1) {
+        m_responses.resize(1);
+    }
+    if(m_iov.capacity() > 64) {
+        m_iov.shrink_to_fit();
+        m_files.shrink_to_fit();
+    }
+}
+
+void HttpConn::trackFootprint_() {
+    size_t bytes = m_readBuff.capacity() + m_writeBuff.capacity();
+    size_t peak = peakFootprint.load(std::memory_order_relaxed);
+    while(bytes > peak && !peakFootprint.compare_exchange_weak(peak, bytes, std::memory_order_relaxed)) {
+    }
+}
+
 // 处理请求并生成响应
+// 客户端可能一次发来多个请求（pipelining），这里把缓冲区里完整的请求都处理掉，
+// 响应按请求顺序排进 m_iov，write() 一次 writev 全部发出
 bool HttpConn::process(){
-    m_request.init();
-    if(m_readBuff.readableBytes() <= 0) {
-        return false;
-    } else if(m_request.parse(m_readBuff)) {
-        LOG_DEBUG("%s", m_request.path().c_str());
-        m_response.init(srcDir, m_request.path(), m_request.isKeepAlive(), 200);
-    } else {
-        m_response.init(srcDir, m_request.path(), false, 400);
-    }
-    m_response.makeResponse(m_writeBuff);
-    // 响应头部信息
-    m_iov[0].iov_base = const_cast<char*>(m_writeBuff.peek());
-    m_iov[0].iov_len = m_writeBuff.readableBytes();
-    m_iovCnt = 1;
-    // 文件映射区
-    if(m_response.fileLen() > 0 && m_response.file()) {
-        m_iov[1].iov_base = m_response.file();   // m_iov[1]指向文件映射区
-        m_iov[1].iov_len = m_response.fileLen();
-        m_iovCnt = 2;
-    }
-    LOG_DEBUG("filesize:%d, %d to %d", m_response.fileLen(), m_iovCnt, ToWriteBytes());
+    assert(m_toWrite == 0);  // 上一批响应发完了才会再来处理
+    trackFootprint_();  // 刚读完，读缓冲区最大的时候
+    // 每个响应的头在 m_writeBuff 里的区间，先记偏移，全部生成完再按段换成 iovec
+    size_t headerEnd[MAX_PIPELINE];
+    while(m_respCnt < MAX_PIPELINE && m_readBuff.readableBytes() > 0) {
+        // 从上次解析到的地方继续，请求不完整就继续读
+        HttpRequest::HTTP_CODE ret = m_request.parse(m_readBuff);
+        if(ret == HttpRequest::NO_REQUEST) {
+            // 客户端在等 100 Continue 才发请求体；前面还有响应没发的话要等它们发完，否则顺序就乱了
+            // 100 Continue 和普通响应一样排进 m_iov 由 write() 发：发不完下次接着发，TLS 记录也不会和后面的响应错开
+            if(m_respCnt == 0 && m_request.takeExpectContinue()) {
+                static const char CONTINUE[] = "HTTP/1.1 100 Continue\r\n\r\n";
+                m_writeBuff.append(CONTINUE, sizeof(CONTINUE) - 1);
+                m_isKeepAlive = true;  // 发完接着读请求体
+            }
+            break;
+        }
+        if(m_respCnt == m_responses.size()) {
+            m_responses.emplace_back(new HttpResponse());
+        }
+        HttpResponse& response = *m_responses[m_respCnt];
+        m_requests++;
+        requests.fetch_add(1, std::memory_order_relaxed);
+        if(ret == HttpRequest::GET_REQUEST) {
+            LOG_DEBUG("%.*s", (int)m_request.path().size(), m_request.path().data());
+            bool keepAlive = m_request.isKeepAlive();
+            if(keepAlive && m_requests >= keepAliveRequests) {
+                keepAlive = false;  // 到上限了，这个响应带 Connection: close，发完就关
+                keepAliveCapped.fetch_add(1, std::memory_order_relaxed);
+            }
+            response.init(srcDir, m_request.path(), keepAlive, 200,
+                          HttpEncoding::parseAccept(m_request.header(HDR_ACCEPT_ENCODING)));
+            response.setKeepAlive(keepAliveTimeout / 1000, keepAliveRequests - m_requests);
+            response.setConditional(m_request.header(HDR_IF_NONE_MATCH), m_request.header(HDR_IF_MODIFIED_SINCE));
+            if(m_request.method() == "GET") {
+                response.setRange(m_request.header(HDR_RANGE), m_request.header(HDR_IF_RANGE));
+            }
+        } else {
+            response.init(srcDir, m_request.path(), false, m_request.errorCode());
+        }
+        response.makeResponse(m_writeBuff);
+        m_isKeepAlive = response.isKeepAlive();  // 没有错误页面的错误响应也会改成关闭
+        headerEnd[m_respCnt++] = m_writeBuff.readableBytes();
+        // 响应已经生成，请求占用的字节可以丢掉了，之后 m_request 里的 string_view 失效
+        if(ret == HttpRequest::GET_REQUEST) {
+            m_readBuff.retrieve(m_request.parsedBytes());
+        } else {
+            m_readBuff.retrieveAll();  // 语法错误没法找到下一个请求的开头，连接也会被关闭
+        }
+        m_request.init();
+        if(!m_isKeepAlive) {
+            break;  // 这个响应发完就关连接，后面的请求不用处理了
+        }
+    }
+    if(m_respCnt == 0) {
+        if(m_writeBuff.readableBytes() == 0) {
+            return false;
+        }
+        m_writeBuff.readableIov(0, m_writeBuff.readableBytes(), m_iov);  // 只有 100 Continue
+    }
+    // 响应头部信息和文件映射区交替排列，响应头直接指向 m_writeBuff 的段，相邻的响应头在同一个段里就合并成一段
+    size_t headerBegin = 0;
+    for(size_t i = 0; i < m_respCnt; i++) {
+        HttpResponse& response = *m_responses[i];
+        m_writeBuff.readableIov(headerBegin, headerEnd[i] - headerBegin, m_iov);
+        headerBegin = headerEnd[i];
+        for(const HttpResponse::Segment& seg : response.segments()) {
+            if(seg.data) {
+                m_iov.push_back({const_cast<char*>(seg.data), seg.len});  // 映射区、缓存条目
+            } else {
+                // 大文件用 sendfile 发，iov_base 为空表示文件段，iov_len 是还没发的长度
+                m_iov.push_back({nullptr, seg.len});
+                m_files.push_back({response.fileFd(), seg.offset});
+            }
+        }
+    }
+    m_toWrite = 0;
+    for(auto& iov : m_iov) {
+        m_toWrite += iov.iov_len;
+    }
+    trackFootprint_();  // 响应头都生成好了
+    LOG_DEBUG("responses:%d, %d iovecs, %d to write", (int)m_respCnt, (int)m_iov.size(), ToWriteBytes());
     return true;
 }
-
@@ -4,7 +4,12 @@
 
 #include <sys/types.h>
 #include <sys/uio.h>
+#include <sys/socket.h> // sendmsg
+#include <sys/sendfile.h>
 #include <arpa/inet.h>
+#include <limits.h>  // IOV_MAX
+#include <vector>
+#include <memory>
 #include <stdlib.h>
 #include <errno.h>
 
@@ -12,6 +17,7 @@
 #include "../log/log.h"
 #include "httpRequest.h"
 #include "httpResponse.h"
+#include "httpTls.h"
 
 /*
 进行读写数据并调用httprequest 来解析数据以及httpresponse来生成响应
@@ -30,31 +36,76 @@ public:
     int getPort() const;  // 获取端口
     const char* getIP() const;
     sockaddr_in getAddr() const;
-    bool process(); // 处理请求
+    bool process(); // 处理请求，读缓冲区里所有完整的请求都会生成响应（pipelining）
+    void shrink(); // 连接空闲时把按需长出来的内存还回去
+    void handoff(); // 连接要换线程处理（交给线程池、重新注册到 epoll、关闭后 fd 被复用）之前调用
 
-    int ToWriteBytes() { return m_iov[0].iov_len + m_iov[1].iov_len; }
+    int ToWriteBytes() { return m_toWrite; }
     
     bool isKeepAlive() const {
-        return m_request.isKeepAlive();
+        return m_isKeepAlive;
     }
 
+    bool isClosed() const { return m_isClose; }
+
+    // 保持的连接上一个请求已经处理完、下一个请求还没开始，这段时间按空闲超时算
+    bool keepAliveIdle() const {
+        return m_requests > 0 && m_toWrite == 0 && m_readBuff.readableBytes() == 0;
+    }
+
+    static const int MAX_PIPELINE = 16; // 一次最多处理多少个流水线请求
+
     static bool isET;
     static const char* srcDir;
     static std::atomic<int> userCount; // 原子操作，用于统计用户数量
+    static std::atomic<uint64_t> sendfileBytes; // 通过 sendfile 发出的字节数
+    static std::atomic<uint64_t> writevBytes; // 从用户态内存（响应头、小文件、缓存）发出的字节数
+    static size_t writeQuantum; // 每次可写事件最多发多少字节，之后让给同一个 reactor 上的其他连接，0 表示不限
+    static std::atomic<uint64_t> writeYields; // 因为用完额度而让出的次数
+    static int keepAliveRequests; // 一个连接最多处理多少个请求，到了就在响应里带 Connection: close，0 表示不保持连接
+    static int keepAliveTimeout; // 保持的连接空闲多久关掉（毫秒），和处理请求时的超时分开
+    static std::atomic<uint64_t> connections; // 累计的连接数
+    static std::atomic<uint64_t> requests; // 累计的请求数，除以连接数就是平均每个连接复用了几次
+    static std::atomic<uint64_t> keepAliveCapped; // 因为达到请求上限而关闭的连接
+    static std::atomic<uint64_t> idleTimeouts; // 因为空闲超时而关闭的连接
+    static std::atomic<size_t> peakFootprint; // 单个连接的读写缓冲区加起来最多占过多少字节
 
 private:
     int m_sockFd;
     sockaddr_in m_addr;
     bool m_isClose;
+    bool m_isKeepAlive; // 上一个请求是否 keep-alive，请求本身处理完就被 retrieve 掉了
+    int m_requests; // 这个连接上已经处理的请求数
+
+    void resetOutput_(); // 响应全部发完，释放文件映射
+    void trackFootprint_();
+    ssize_t readTls_(int* saveErrno);
+    ssize_t writeTls_(int* saveErrno); // 发送方向没有 kTLS 时用 SSL_write 加密
+    bool handshake_(int* saveErrno);
+
+    SSL* m_ssl; // 没开 HTTPS 时为空
+    bool m_tlsReady; // 握手完成
+    bool m_ktlsTx; // 发送方向由内核加密，可以直接 sendmsg/sendfile
 
-    int m_iovCnt;
-    struct iovec m_iov[2];
+    // 按顺序排好的待发送数据：各个响应的头（在 m_writeBuff 里）、文件映射区、缓存条目，连续的内存段一次 sendmsg 发出去
+    // iov_base 为空的是文件段，用 sendfile 发，按顺序对应 m_files
+    struct FileSeg {
+        int fd;
+        off_t offset; // 下一次从哪里开始发
+    };
+    std::vector<struct iovec> m_iov;
+    size_t m_iovIdx; // 第一个还没发完的 iovec
+    std::vector<FileSeg> m_files;
+    size_t m_fileIdx; // 第一个还没发完的文件段
+    size_t m_toWrite; // 还剩多少字节没发
 
     Buffer m_readBuff;  // 读缓冲区，从·socket读 request，存到这里
     Buffer m_writeBuff; // 写缓冲区，生成的 response 写到这里
 
     HttpRequest m_request; // 解析请求
-    HttpResponse m_response; // 生成响应
+    // 生成响应，一个流水线请求一个，对象复用不释放；发送完之前文件映射要一直留着
+    std::vector<std::unique_ptr<HttpResponse>> m_responses;
+    size_t m_respCnt; // 本轮用了几个
 };
 
 
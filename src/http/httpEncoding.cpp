@@ -0,0 +1,81 @@
+#include "httpEncoding.h"
+#include <strings.h> // strncasecmp
+
+static bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && strncasecmp(a.data(), b.data(), a.size()) == 0;
+}
+
+static std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+// 形如 "gzip, deflate;q=0.5, br;q=1.0"
+int HttpEncoding::parseAccept(std::string_view value) {
+    int accepted = 0;
+    while (!value.empty()) {
+        size_t comma = value.find(',');
+        std::string_view item = value.substr(0, comma);
+        value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+
+        size_t semi = item.find(';');
+        std::string_view coding = trim(item.substr(0, semi));
+        if (semi != std::string_view::npos) {
+            // q=0 / q=0.0 / q=0.000 表示明确不接受
+            std::string_view param = trim(item.substr(semi + 1));
+            if (param.size() >= 3 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '='
+                && param.substr(2).find_first_not_of("0.") == std::string_view::npos) {
+                continue;
+            }
+        }
+        if (equalsIgnoreCase(coding, "gzip") || equalsIgnoreCase(coding, "x-gzip")) {
+            accepted |= GZIP;
+        } else if (equalsIgnoreCase(coding, "br")) {
+            accepted |= BR;
+        } else if (coding == "*") {
+            accepted |= GZIP | BR;
+        }
+    }
+    return accepted;
+}
+
+bool HttpEncoding::compressible(std::string_view mime) {
+    return mime.substr(0, 5) == "text/" || mime.find("xml") != std::string_view::npos
+        || mime.find("javascript") != std::string_view::npos || mime.find("json") != std::string_view::npos;
+}
+
+bool HttpEncoding::compress(ENCODING enc, const char* data, size_t len, std::string& out, bool best) {
+    if (enc == BR) {
+        size_t outLen = BrotliEncoderMaxCompressedSize(len);
+        out.resize(outLen);
+        int quality = best ? BR_BEST_QUALITY : BR_QUALITY;
+        if (!BrotliEncoderCompress(quality, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, len, (const uint8_t*)data,
+                                   &outLen, (uint8_t*)&out[0])) {
+            return false;
+        }
+        out.resize(outLen);
+        return true;
+    }
+    if (enc == GZIP) {
+        z_stream zs = {};
+        // windowBits 加 16 表示输出 gzip 格式而不是 zlib 格式
+        if (deflateInit2(&zs, best ? GZIP_BEST_LEVEL : GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return false;
+        }
+        out.resize(deflateBound(&zs, len));
+        zs.next_in = (Bytef*)data;
+        zs.avail_in = len;
+        zs.next_out = (Bytef*)&out[0];
+        zs.avail_out = out.size();
+        int ret = deflate(&zs, Z_FINISH);
+        out.resize(zs.total_out);
+        deflateEnd(&zs);
+        return ret == Z_STREAM_END;
+    }
+    return false;
+}
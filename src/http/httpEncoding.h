@@ -0,0 +1,45 @@
+#ifndef HTTPENCODING_H
+#define HTTPENCODING_H
+
+#include <string>
+#include <string_view>
+#include <zlib.h>
+#include <brotli/encode.h>
+
+// 内容编码：解析 Accept-Encoding，判断类型是否值得压缩，以及 gzip/brotli 压缩
+class HttpEncoding {
+public:
+    // 编码方式，Accept-Encoding 解析出来是这些位的组合
+    enum ENCODING {
+        IDENTITY = 0,
+        GZIP = 1,
+        BR = 2,
+    };
+
+    // 客户端接受的编码，q=0 的视为不接受，"*" 表示都接受
+    static int parseAccept(std::string_view value);
+    // 在客户端接受的编码里选一个，brotli 优先
+    static ENCODING choose(int accepted) {
+        return (accepted & BR) ? BR : (accepted & GZIP) ? GZIP : IDENTITY;
+    }
+    // 文本类的类型才压缩，图片、视频本身已经压缩过了
+    static bool compressible(std::string_view mime);
+
+    // Content-Encoding 的值
+    static std::string_view name(ENCODING enc) { return enc == BR ? "br" : enc == GZIP ? "gzip" : ""; }
+    // 预压缩文件的后缀，xxx.css 对应 xxx.css.br / xxx.css.gz
+    static std::string_view suffix(ENCODING enc) { return enc == BR ? ".br" : enc == GZIP ? ".gz" : ""; }
+
+    // 压缩失败返回 false。缓存未命中时在 reactor 线程里同步压缩，会卡住整个事件循环，
+    // 所以默认用中等级别：结果比最高级别大几个百分点，但快几倍；best 给离线打包用
+    static bool compress(ENCODING enc, const char* data, size_t len, std::string& out, bool best = false);
+
+    static const int BR_QUALITY = 4;
+    static const int GZIP_LEVEL = 6;
+    static const int BR_BEST_QUALITY = 11;
+    static const int GZIP_BEST_LEVEL = 9;
+
+    static const size_t MIN_SIZE = 1024; // 太小的文件压缩不划算
+};
+
+#endif // HTTPENCODING_H
@@ -0,0 +1,128 @@
+#include "httpFileCache.h"
+#include <errno.h>
+
+HttpFileCache* HttpFileCache::instance() {
+    static HttpFileCache cache;
+    return &cache;
+}
+
+HttpFileCache::HttpFileCache() : m_maxEntries(0), m_shardEntries(0), m_validSec(0),
+    m_hits(0), m_negativeHits(0), m_misses(0), m_evictions(0), m_entries(0) {}
+
+// 在服务器启动前调用，之后分片数不再变化
+void HttpFileCache::init(size_t maxEntries, int validSec, int shardNum) {
+    assert(shardNum > 0);
+    clear();
+    m_shards.clear();
+    for (int i = 0; i < shardNum; i++) {
+        m_shards.emplace_back(new Shard());
+    }
+    m_maxEntries = maxEntries;
+    m_shardEntries = std::max<size_t>(1, maxEntries / shardNum);
+    m_validSec = validSec;
+}
+
+HttpFileCache::Shard& HttpFileCache::shard_(const std::string& path) {
+    return *m_shards[std::hash<std::string>()(path) % m_shards.size()];
+}
+
+// 粗粒度的单调时钟，走 vDSO，不进内核
+time_t HttpFileCache::now_() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return ts.tv_sec;
+}
+
+// 先 open 再 fstat，属性和 fd 指向的是同一个文件；目录不留 fd
+HttpOpenFilePtr HttpFileCache::load_(const std::string& path, time_t now) const {
+    std::shared_ptr<HttpOpenFile> file = std::make_shared<HttpOpenFile>();
+    file->expire = now + m_validSec;
+    file->fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file->fd < 0) {
+        // 没有权限打开的文件还要知道它存在，好回 403 而不是 404
+        if (stat(path.c_str(), &file->st) < 0) {
+            file->err = errno;
+        }
+        return file;
+    }
+    if (fstat(file->fd, &file->st) < 0) {
+        file->err = errno;
+    }
+    if (file->err || !S_ISREG(file->st.st_mode)) {
+        close(file->fd);
+        file->fd = -1;
+    }
+    return file;
+}
+
+HttpOpenFilePtr HttpFileCache::open(const std::string& path) {
+    time_t now = now_();
+    if (!enabled()) {
+        return load_(path, now);
+    }
+    Shard& s = shard_(path);
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> locker(s.mtx);
+        generation = s.generation;
+        auto it = s.index.find(path);
+        if (it != s.index.end() && it->second->file->expire > now) {
+            s.lru.splice(s.lru.begin(), s.lru, it->second);
+            m_hits++;
+            if (it->second->file->err) {
+                m_negativeHits++;
+            }
+            return it->second->file;
+        }
+    }
+    m_misses++;
+    // 打开文件不占着锁，两个线程同时未命中就都打开一次，后放进去的替换前面的
+    HttpOpenFilePtr file = load_(path, now);
+    std::lock_guard<std::mutex> locker(s.mtx);
+    // 打开期间有过 erase/clear：打开的可能是变化之前的文件，放进来就会一直发旧内容到过期，这次用完就算了
+    if (s.generation != generation) {
+        return file;
+    }
+    auto it = s.index.find(path);
+    if (it == s.index.end()) {
+        s.lru.emplace_front();
+        s.lru.front().path = path;
+        it = s.index.emplace(path, s.lru.begin()).first;
+        m_entries++;
+    } else {
+        s.lru.splice(s.lru.begin(), s.lru, it->second);
+    }
+    it->second->file = file;
+    while (s.lru.size() > m_shardEntries) {
+        s.index.erase(s.lru.back().path);
+        s.lru.pop_back();
+        m_entries--;
+        m_evictions++;
+    }
+    return file;
+}
+
+void HttpFileCache::erase(const std::string& path) {
+    if (!enabled()) {
+        return;
+    }
+    Shard& s = shard_(path);
+    std::lock_guard<std::mutex> locker(s.mtx);
+    s.generation++;
+    auto it = s.index.find(path);
+    if (it != s.index.end()) {
+        s.lru.erase(it->second);
+        s.index.erase(it);
+        m_entries--;
+    }
+}
+
+void HttpFileCache::clear() {
+    for (auto& s : m_shards) {
+        std::lock_guard<std::mutex> locker(s->mtx);
+        s->generation++;
+        m_entries -= s->lru.size();
+        s->index.clear();
+        s->lru.clear();
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef HTTPFILECACHE_H
+#define HTTPFILECACHE_H
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <assert.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// 打开过的文件：普通文件留着只读的 fd，st 是打开时 fstat 的结果；
+// err 非 0 表示文件不存在或打不开（负缓存），这时 st 无效
+struct HttpOpenFile {
+    int fd = -1;
+    struct stat st = {};
+    int err = 0;
+    time_t expire = 0;  // 过期时间，单调时钟的秒
+    ~HttpOpenFile() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+};
+typedef std::shared_ptr<const HttpOpenFile> HttpOpenFilePtr;
+
+// 打开文件缓存，类似 nginx 的 open_file_cache：缓存 fd、stat 结果和不存在的路径，
+// 同一个文件不用每个请求都 stat/open 一遍，扫描器成千上万的 404 也只在第一次碰文件系统。
+// 按路径分片的 LRU，按条目数限制大小；条目过了有效期重新打开，FileWatcher 看到文件变化时直接删掉。
+// fd 跟着 shared_ptr 走，被淘汰时还在 sendfile 的连接不受影响。所有 reactor、工作线程共用。
+class HttpFileCache {
+public:
+    static HttpFileCache* instance();
+
+    // maxEntries: 条目数上限，0 表示不缓存；validSec: 有效期（秒）
+    void init(size_t maxEntries, int validSec, int shardNum = 16);
+
+    // 总是返回非空，不缓存时每次都重新打开
+    HttpOpenFilePtr open(const std::string& path);
+    void erase(const std::string& path);
+    void clear();
+
+    bool enabled() const { return m_maxEntries > 0; }
+
+    // 统计
+    uint64_t hits() const { return m_hits; }
+    uint64_t negativeHits() const { return m_negativeHits; }
+    uint64_t misses() const { return m_misses; }
+    uint64_t evictions() const { return m_evictions; }
+    size_t entries() const { return m_entries; }
+
+private:
+    HttpFileCache();
+    ~HttpFileCache() = default;
+
+    struct Node {
+        std::string path;
+        HttpOpenFilePtr file;
+    };
+    struct Shard {
+        std::mutex mtx;
+        std::list<Node> lru;  // 头部是最近用过的
+        std::unordered_map<std::string, std::list<Node>::iterator> index;
+        uint64_t generation = 0;  // 这个分片每次 erase/clear 加一，未命中打开文件期间变了就不放进来
+    };
+    Shard& shard_(const std::string& path);
+    HttpOpenFilePtr load_(const std::string& path, time_t now) const;
+    static time_t now_();
+
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    size_t m_maxEntries;
+    size_t m_shardEntries;
+    int m_validSec;
+
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_negativeHits;
+    std::atomic<uint64_t> m_misses;
+    std::atomic<uint64_t> m_evictions;
+    std::atomic<size_t> m_entries;
+};
+
+#endif // HTTPFILECACHE_H
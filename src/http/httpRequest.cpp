@@ -1,118 +1,373 @@
 #include "httpRequest.h"
 
-const std::unordered_set<std::string> HttpRequest::DEFAULT_HTML{
-    "/index", "/register", "/login",
-    "/welcome", "/video", "/picture",
-}; // 默认html文件
+// 默认html文件，请求路径 -> 改写后的路径
+static constexpr auto DEFAULT_HTML = makeStaticMap<std::string_view>({
+    {"/", "/index.html"},
+    {"/index", "/index.html"}, {"/register", "/register.html"}, {"/login", "/login.html"},
+    {"/welcome", "/welcome.html"}, {"/video", "/video.html"}, {"/picture", "/picture.html"},
+});
 
-const std::unordered_map<std::string, int> HttpRequest::DEFAULT_HTML_TAG{
-    {"/register.html", 0}, {"/login.html", 1}
-}; // 默认html文件标签
+// 默认html文件标签
+static constexpr auto DEFAULT_HTML_TAG = makeStaticMap<int>({
+    {"/register.html", 0}, {"/login.html", 1},
+});
+
+size_t HttpRequest::maxHeaderSize = 8192;
+size_t HttpRequest::maxBodySize = 1 << 20;
 
 void HttpRequest::init() {
     m_state = REQUEST_LINE;
-    m_method = m_path = m_version = m_body = "";
-    m_headers.clear();  // 请求头是key-value形式的，所以用unordered_map
+    m_buff = nullptr;
+    m_parsed = 0;
+    m_bodyLeft = 0;
+    m_bodyLen = 0;
+    m_errorCode = 0;
+    m_collectBody = false;
+    m_expectContinue = false;
+    m_sink = nullptr;
+    m_method = m_path = m_version = Slice();
+    m_pathRewrite = std::string_view();
+    m_normPath.clear();
+    m_body.clear();
+    m_knownMask = 0;  // 常用请求头不用清空，看掩码就知道有没有
+    m_otherHeaders.clear();  // 请求头只存偏移，clear 不释放内存，下个请求直接复用
     m_post.clear(); // POST请求的参数也是key-value形式的，所以用unordered_map
 }
 
-// http 1.1 支持持久连接，所以需要判断是否是keep-alive
+// Connection 是逗号分隔的 token 列表，大小写不敏感（RFC 7230 6.1）
+// HTTP/1.1 默认保持连接，除非带了 close；HTTP/1.0 默认关闭，除非带了 keep-alive
 bool HttpRequest::isKeepAlive() const {
-    if (m_headers.count("Connection") == 1) {
-        return m_headers.find("Connection")->second == "keep-alive" && m_version == "1.1";
+    bool keepAlive = version() == "1.1";
+    std::string_view list = header(HDR_CONNECTION);
+    while (!list.empty()) {
+        size_t comma = list.find(',');
+        std::string_view token = list.substr(0, comma);
+        list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+        while (!token.empty() && (token.front() == ' ' || token.front() == '\t')) token.remove_prefix(1);
+        while (!token.empty() && (token.back() == ' ' || token.back() == '\t')) token.remove_suffix(1);
+        if (token.size() == 5 && strncasecmp(token.data(), "close", 5) == 0) {
+            return false;
+        }
+        if (token.size() == 10 && strncasecmp(token.data(), "keep-alive", 10) == 0) {
+            keepAlive = true;
+        }
     }
-    return false;
+    return keepAlive;
 }
 
-// 解析请求行
-bool HttpRequest::parse(Buffer& buff) {
-    const char CRLF[] = "\r\n";  // 回车换行结束符
-    if (buff.readableBytes() <= 0) {
-        return false;
-    }
-    while (buff.readableBytes() && m_state != FINISH) {
-        // 在buff中查找CRLF,后两个是查找字符 前面是查找的范围
-        // 输出的是子字符串在主字符串中的位置
-        const char* lineEnd = std::search(buff.peek(), const_cast<const char*>(buff.beginWrite()), CRLF, CRLF + 2); 
-        std::string line(buff.peek(), lineEnd); // 转换数据，左闭右开区间
+void HttpRequest::setBodySink(const BodySink& sink) {
+    m_sink = sink;
+}
+
+bool HttpRequest::takeExpectContinue() {
+    bool ret = m_expectContinue;
+    m_expectContinue = false;
+    return ret;
+}
+
+HttpRequest::HTTP_CODE HttpRequest::error_(int code) {
+    m_errorCode = code;
+    LOG_WARN("Parse request error: %d", code);
+    return BAD_REQUEST;
+}
+
+// 增量解析：从上次解析到的位置继续，一行不完整就等下次读到更多数据
+// 请求体（包括 chunked 的分块头）交给 sink 之后立即从缓冲区删掉，缓冲区里只留请求行和请求头
+HttpRequest::HTTP_CODE HttpRequest::parse(Buffer& buff) {
+    m_buff = &buff;
+    while (m_state != FINISH) {
+        if (m_state == BODY || m_state == CHUNK_DATA) {
+            // 请求体可能分在好几个段里，一段一段交给 sink，不用合并
+            size_t avail = 0;
+            const char* pos = buff.peekAt(m_parsed, &avail);
+            if (avail == 0) {
+                return NO_REQUEST;  // 请求体还没收全
+            }
+            size_t n = std::min(avail, m_bodyLeft);
+            if (!feedBody_(pos, n)) {
+                return error_(413);
+            }
+            buff.erase(m_parsed, n);
+            m_bodyLeft -= n;
+            if (m_bodyLeft == 0) {
+                m_state = m_state == BODY ? FINISH : CHUNK_CRLF;
+            }
+            continue;
+        }
+        // 请求行、请求头和分块头要从 peek() 开始连续，合并段和 erase 都会让地址变，所以每轮都重新取，只保存偏移
+        // 一行超过 maxHeaderSize 就是错误，所以只需要前 m_parsed + maxHeaderSize 多一点连续，后面的请求体不合并
+        size_t window = std::min(buff.readableBytes(), m_parsed + maxHeaderSize + 2);
+        const char* base = buff.peekContiguous(window);
+        const char* end = base + window;
+        const char* pos = base + m_parsed;
+        if (m_state == CHUNK_CRLF) {
+            // 每块数据后面紧跟一个 CRLF
+            if (end - pos < 2) {
+                return NO_REQUEST;
+            }
+            if (pos[0] != '\r' || pos[1] != '\n') {
+                return error_(400);
+            }
+            buff.erase(m_parsed, 2);
+            m_state = CHUNK_SIZE;
+            continue;
+        }
+        // 在 [pos, end) 中查找CRLF，一次比较 16/32 字节
+        const char* lineEnd = HttpScanner::findCRLF(pos, end);
+        if (lineEnd == end) {
+            // 这一行还不完整；请求头已经超过上限就直接拒绝，不用等它发完
+            if ((m_state == REQUEST_LINE || m_state == HEADERS) && static_cast<size_t>(end - base) > maxHeaderSize) {
+                return error_(431);
+            }
+            if ((m_state == CHUNK_SIZE || m_state == CHUNK_TRAILER) && static_cast<size_t>(end - pos) > maxHeaderSize) {
+                return error_(400);
+            }
+            return NO_REQUEST;
+        }
         switch (m_state) {
             case REQUEST_LINE:
-                if (!parseRequestLine(line)) {
-                    return false;
+                if (!parseRequestLine(pos, lineEnd)) {
+                    return error_(400);
                 }
-                parsePath();
+                if (!parsePath()) {
+                    return error_(400);
+                }
+                m_parsed = lineEnd + 2 - base; // 跳过回车换行
                 break;
             case HEADERS:
-                parseHeader(line);
-                // 如果buff中只有一个回车换行，说明请求头解析完了
-                if (buff.readableBytes() <= 2) {
-                    m_state = FINISH;
+                m_parsed = lineEnd + 2 - base;
+                if (m_parsed > maxHeaderSize) {
+                    return error_(431);
+                }
+                if (pos == lineEnd) {
+                    // 空行，请求头解析完了，决定请求体怎么收
+                    int code = parseFraming_();
+                    if (code) {
+                        return error_(code);
+                    }
+                } else if (!parseHeader(pos, lineEnd)) {
+                    return error_(400);
                 }
                 break;
-            case BODY:
-                parseBody(line);
+            case CHUNK_SIZE: {
+                // 分块大小是十六进制，后面可能跟 ";扩展"
+                size_t size = 0;
+                const char* p = pos;
+                for (; p < lineEnd && *p != ';'; p++) {
+                    int v = ConverHex(*p);
+                    if (v < 0 || size > (maxBodySize << 4)) {
+                        return error_(400);
+                    }
+                    size = size * 16 + v;
+                }
+                if (p == pos) {
+                    return error_(400);
+                }
+                buff.erase(m_parsed, lineEnd + 2 - pos);
+                if (size == 0) {
+                    m_state = CHUNK_TRAILER;  // 最后一块，后面是可选的 trailer
+                } else if (m_bodyLen + size > maxBodySize) {
+                    return error_(413);
+                } else {
+                    m_bodyLeft = size;
+                    m_state = CHUNK_DATA;
+                }
+                break;
+            }
+            case CHUNK_TRAILER:
+                // trailer 不用，直接丢掉，空行表示结束
+                buff.erase(m_parsed, lineEnd + 2 - pos);
+                if (pos == lineEnd) {
+                    m_state = FINISH;
+                }
                 break;
             default:
                 break;
         }
-        // 读完了
-        if (lineEnd == buff.beginWrite()) {
-            break;
+    }
+    if (m_collectBody) {
+        parsePost();  // 只有表单才需要解析请求体
+    }
+    LOG_DEBUG("request line: %.*s, %.*s, %.*s, body: %d", (int)method().size(), method().data(),
+              (int)path().size(), path().data(), (int)version().size(), version().data(), (int)m_bodyLen);
+    return GET_REQUEST;
+}
+
+// 请求头收完之后，根据 Transfer-Encoding / Content-Length 决定请求体的长度，返回非0表示错误码
+int HttpRequest::parseFraming_() {
+    std::string_view te = header(HDR_TRANSFER_ENCODING);
+    std::string_view cl = header(HDR_CONTENT_LENGTH);
+    if (!te.empty()) {
+        if (te.size() != 7 || strncasecmp(te.data(), "chunked", 7) != 0) {
+            return 501;  // 只支持 chunked
+        }
+        if (!cl.empty()) {
+            return 400;  // 两个都有是请求走私的典型手法
         }
-        buff.retrieveUntil(lineEnd + 2); // 跳过回车换行
+        m_state = CHUNK_SIZE;
+    } else {
+        size_t len = 0;
+        for (char ch : cl) {
+            if (ch < '0' || ch > '9') {
+                return 400;
+            }
+            if (len <= maxBodySize) {
+                len = len * 10 + (ch - '0');  // 超过上限就不用再算了，防止溢出
+            }
+        }
+        // 声明的长度超过上限，不用收请求体就能拒绝
+        if (len > maxBodySize) {
+            return 413;
+        }
+        m_bodyLeft = len;
+        m_state = len > 0 ? BODY : FINISH;
+    }
+    if (m_state != FINISH) {
+        m_collectBody = method() == "POST" && header(HDR_CONTENT_TYPE) == "application/x-www-form-urlencoded";
+        // HTTP/1.0 的客户端不认识 100，Expect 要忽略（RFC 7231 5.1.1）
+        std::string_view expect = header(HDR_EXPECT);
+        m_expectContinue = version() == "1.1" && expect.size() == 12
+                           && strncasecmp(expect.data(), "100-continue", 12) == 0;
+    }
+    return 0;
+}
+
+// 收到一段请求体：有 sink 交给 sink，表单攒到 m_body 里，其他的丢弃
+bool HttpRequest::feedBody_(const char* data, size_t len) {
+    m_bodyLen += len;
+    if (m_bodyLen > maxBodySize) {
+        return false;
+    }
+    if (m_sink) {
+        return m_sink(data, len);
+    }
+    if (m_collectBody) {
+        m_body.append(data, len);
     }
-    LOG_DEBUG("request line: %s, %s, %s", m_method.c_str(), m_path.c_str(), m_version.c_str());
     return true;
 }
 
-// 解析路径，看是哪个html文件
-void HttpRequest::parsePath() {
-    if (m_path == "/") {
-        m_path = "/index.html";
-    } else {
-        for (auto& item : DEFAULT_HTML) {
-            if (item == m_path) {
-                m_path += ".html";
-                break;
+std::string_view HttpRequest::view_(const Slice& s) const {
+    if (!m_buff || s.len == 0) {
+        return std::string_view();
+    }
+    return std::string_view(m_buff->peekContiguous(s.off + s.len) + s.off, s.len);
+}
+
+HttpRequest::Slice HttpRequest::slice_(const char* begin, const char* end) const {
+    Slice s;
+    s.off = static_cast<uint32_t>(begin - m_buff->peekContiguous(0));  // parse 里已经合并过，这里只取开头
+    s.len = static_cast<uint32_t>(end - begin);
+    return s;
+}
+
+// 规范化路径：去掉 ?query 和 #fragment，合并连续的 '/'，去掉 "." 段，".." 回退一级，退到根目录以上的拒绝。
+// 响应缓存的 key、要打开的文件、打开文件缓存的 key 都从这一个结果来，同一个文件只有一种写法，
+// FileWatcher 按路径删缓存时不会漏掉 "/css//style.css" 这样的别名。
+// 绝大多数请求路径本来就是规范的，直接用缓冲区里的那一段，不拷贝
+bool HttpRequest::parsePath() {
+    std::string_view target = view_(m_path);
+    size_t cut = target.find_first_of("?#");
+    if (cut != std::string_view::npos) {
+        target = target.substr(0, cut);
+        m_path.len = static_cast<uint32_t>(cut);
+    }
+    if (target.empty() || target[0] != '/') {
+        return false;
+    }
+    if (!isNormalPath_(target)) {
+        bool dir = false;  // 最后一段是空的、"." 或 ".."，结果是目录，要保留结尾的 '/'
+        size_t i = 0;
+        while (i < target.size()) {
+            size_t next = target.find('/', i + 1);
+            if (next == std::string_view::npos) {
+                next = target.size();
             }
+            std::string_view seg = target.substr(i + 1, next - i - 1);
+            dir = seg.empty() || seg == "." || seg == "..";
+            if (seg == "..") {
+                if (m_normPath.empty()) {
+                    return false;
+                }
+                m_normPath.resize(m_normPath.rfind('/'));
+            } else if (!dir) {
+                m_normPath += '/';
+                m_normPath.append(seg);
+            }
+            i = next;
+        }
+        if (dir || m_normPath.empty()) {
+            m_normPath += '/';
         }
     }
+    // 看是哪个html文件
+    const std::string_view* rewrite = DEFAULT_HTML.find(path());
+    if (rewrite) {
+        m_pathRewrite = *rewrite;
+    }
+    return true;
 }
 
-// 解析请求行
-bool HttpRequest::parseRequestLine(const std::string& line) {
-    // 在匹配规则中，以括号()的方式来划分组别 一共三个括号 [0]表示整体
-    std::regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
-    std::smatch subMatch;
-    if (std::regex_match(line, subMatch, patten)) {
-        m_method = subMatch[1];
-        m_path = subMatch[2];
-        m_version = subMatch[3];
-        m_state = HEADERS;
-        return true;
-    }
-    LOG_ERROR("Parse RequestLine Error");
-    return false;
+bool HttpRequest::isNormalPath_(std::string_view path) {
+    for (size_t i = 0; i < path.size(); i++) {
+        if (path[i] != '/') {
+            continue;
+        }
+        size_t j = i + 1;  // 这一段的开头
+        if (j < path.size() && path[j] == '/') {
+            return false;
+        }
+        if (j < path.size() && path[j] == '.') {
+            size_t k = (j + 1 < path.size() && path[j + 1] == '.') ? j + 2 : j + 1;
+            if (k == path.size() || path[k] == '/') {
+                return false;
+            }
+        }
+    }
+    return true;
 }
 
-// 解析请求头
-void HttpRequest::parseHeader(const std::string& line) {
-    // key: value ？代表0次或1次
-    std::regex patten("^([^:]*): ?(.*)$");
-    std::smatch subMatch;
-    if (std::regex_match(line, subMatch, patten)) {
-        m_headers[subMatch[1]] = subMatch[2];  // key-value形式
-    } else {
-        m_state = BODY;  // 代表头部解析完了，要去解析请求体
+// 解析请求行 "方法 路径 HTTP/版本"，不再用正则，直接找空格
+bool HttpRequest::parseRequestLine(const char* begin, const char* end) {
+    const char* sp1 = HttpScanner::findChar(begin, end, ' ');
+    const char* sp2 = sp1 == end ? end : HttpScanner::findChar(sp1 + 1, end, ' ');
+    const char* ver = sp2 + 1;
+    if (!HttpScanner::isToken(begin, sp1) || sp2 == end || sp2 == sp1 + 1
+        || end - ver <= 5 || std::string_view(ver, 5) != "HTTP/"
+        || HttpScanner::findChar(ver, end, ' ') != end) {
+        LOG_ERROR("Parse RequestLine Error");
+        return false;
     }
+    m_method = slice_(begin, sp1);
+    m_path = slice_(sp1 + 1, sp2);
+    m_version = slice_(ver + 5, end);
+    m_state = HEADERS;
+    return true;
 }
 
-// 解析请求体
-void HttpRequest::parseBody(const std::string& line) {
-    m_body = line;
-    parsePost();  // get请求没有请求体，所以只有post请求才需要解析请求体
-    m_state = FINISH;
-    LOG_DEBUG("Body: %s, len: %d", line.c_str(), line.size());
+// 解析请求头 "key: value"，value 去掉首尾的空白
+bool HttpRequest::parseHeader(const char* begin, const char* end) {
+    const char* colon = HttpScanner::findChar(begin, end, ':');
+    if (colon == end || !HttpScanner::isToken(begin, colon)) {
+        return false;  // 没有冒号，或者名字里有非法字符
+    }
+    const char* vBegin = colon + 1;
+    while (vBegin < end && (*vBegin == ' ' || *vBegin == '\t')) {
+        vBegin++;
+    }
+    const char* vEnd = end;
+    while (vEnd > vBegin && (vEnd[-1] == ' ' || vEnd[-1] == '\t')) {
+        vEnd--;
+    }
+    // 常用请求头按编号存，重复出现时以第一个为准；其他的放进线性表
+    const HTTP_HEADER* id = KNOWN_HEADERS.find(std::string_view(begin, colon - begin));
+    if (!id) {
+        m_otherHeaders.emplace_back(slice_(begin, colon), slice_(vBegin, vEnd));  // key-value形式
+    } else if (!(m_knownMask & (1u << *id))) {
+        m_knownMask |= 1u << *id;
+        m_known[*id] = slice_(vBegin, vEnd);
+    }
+    return true;
 }
 
 // 16进制转为10进制
@@ -129,18 +384,20 @@ int HttpRequest::ConverHex(char ch) {
 }
 // 解析POST请求
 void HttpRequest::parsePost() {
-    if (m_method == "POST" && m_headers["Content-Type"] == "application/x-www-form-urlencoded") {
+    if (method() == "POST" && header(HDR_CONTENT_TYPE) == "application/x-www-form-urlencoded") {
+        LOG_DEBUG("Body: %s, len: %d", m_body.c_str(), m_body.size());
         parseFromUrlencoded();
-        if (DEFAULT_HTML_TAG.count(m_path)) {
-            int tag = DEFAULT_HTML_TAG.find(m_path)->second;
+        const int* it = DEFAULT_HTML_TAG.find(path());
+        if (it) {
+            int tag = *it;
             LOG_DEBUG("Tag: %d", tag);
             if (tag == 0 || tag == 1) {
                 // 用户验证
                 bool isLogin = (tag == 1);
                 if (UserVerify(m_post["username"], m_post["password"], isLogin)) {
-                    m_path = "/welcome.html";
+                    m_pathRewrite = "/welcome.html";
                 } else {
-                    m_path = "/error.html";
+                    m_pathRewrite = "/error.html";
                 }
             }
         }
@@ -260,20 +517,41 @@ bool HttpRequest::UserVerify(const std::string& name, const std::string& pwd, bo
     return flag;
 }
 
-std::string HttpRequest::path() const {
-    return m_path;
+std::string_view HttpRequest::path() const {
+    if (!m_pathRewrite.empty()) {
+        return m_pathRewrite;
+    }
+    if (!m_normPath.empty()) {
+        return m_normPath;
+    }
+    return view_(m_path);
+}
+
+std::string_view HttpRequest::method() const {
+    return view_(m_method);
 }
 
-std::string& HttpRequest::path() {
-    return m_path;
+std::string_view HttpRequest::version() const {
+    return view_(m_version);
 }
 
-std::string HttpRequest::method() const {
-    return m_method;
+std::string_view HttpRequest::header(HTTP_HEADER id) const {
+    return (m_knownMask & (1u << id)) ? view_(m_known[id]) : std::string_view();
 }
 
-std::string HttpRequest::version() const {
-    return m_version;
+// 常用请求头查表直接取；剩下的一般没几个，线性比较比哈希还快，而且不用构造 std::string
+std::string_view HttpRequest::header(std::string_view key) const {
+    const HTTP_HEADER* id = KNOWN_HEADERS.find(key);
+    if (id) {
+        return header(*id);
+    }
+    for (auto& kv : m_otherHeaders) {
+        std::string_view name = view_(kv.first);
+        if (name.size() == key.size() && strncasecmp(name.data(), key.data(), key.size()) == 0) {
+            return view_(kv.second);
+        }
+    }
+    return std::string_view();
 }
 
 std::string HttpRequest::getPost(const std::string& key) const {
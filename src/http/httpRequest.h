@@ -2,59 +2,115 @@
 #define HTTPREQUEST_H
 
 #include <unordered_map>
-#include <unordered_set>
 #include <string>
-#include <regex>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <functional>
 #include <errno.h>
+#include <strings.h>  // strncasecmp
 #include <mysql/mysql.h>
 
 #include "../buffer/buffer.h"
 #include "../log/log.h"
 #include "../pool/sqlconnpool.h"
+#include "httpScanner.h"
+#include "httpTables.h"
 
 // 写如何处理请求报文的
+// 解析是增量的：数据不完整时 parse() 返回 NO_REQUEST，下次读到更多数据后从断点继续，
+// 已经解析过的行不会再扫描。请求行和请求头不拷贝，只记录在读缓冲区里的偏移，
+// 所以在 HttpConn 把这个请求 retrieve 掉之前，path()/method()/header() 返回的 string_view 都有效。
+// 请求体按 Content-Length 或 chunked 分帧，边收边交给 sink 并从缓冲区删掉，读缓冲区不会随请求体增长。
 class HttpRequest{
 public:
     enum PARSE_STATE{
         REQUEST_LINE,
         HEADERS,
-        BODY,
+        BODY,           // 按 Content-Length 收请求体
+        CHUNK_SIZE,     // chunked：分块大小那一行
+        CHUNK_DATA,     // chunked：分块数据
+        CHUNK_CRLF,     // chunked：分块数据后面的 CRLF
+        CHUNK_TRAILER,  // chunked：最后一块之后的 trailer
         FINISH,
     };
+    // parse() 的结果
+    enum HTTP_CODE {
+        NO_REQUEST,   // 请求还不完整，需要继续读
+        GET_REQUEST,  // 读到了一个完整的请求
+        BAD_REQUEST,  // 请求有错，具体的状态码见 errorCode()
+    };
+    // 请求体的接收者，返回 false 中止请求
+    typedef std::function<bool(const char* data, size_t len)> BodySink;
+
     HttpRequest() { init(); }
     ~HttpRequest() = default;
 
     void init();
-    bool parse(Buffer& buff);
+    HTTP_CODE parse(Buffer& buff);
+    // BAD_REQUEST 时的状态码：400 语法错误，413 请求体太大，431 请求头太大，501 不支持的 Transfer-Encoding
+    int errorCode() const { return m_errorCode; }
+    // 请求头里有 Expect: 100-continue，调用方需要先回一个 100 Continue，只返回一次 true
+    bool takeExpectContinue();
+    // 自定义请求体的接收者，不设置时表单攒到内存里解析，其他请求体直接丢弃
+    void setBodySink(const BodySink& sink);
+    // 当前请求在读缓冲区里占了多少字节，处理完之后 retrieve 掉
+    size_t parsedBytes() const { return m_parsed; }
 
-    std::string path() const;
-    std::string& path();
-    std::string method() const;
-    std::string version() const;
+    std::string_view path() const;
+    std::string_view method() const;
+    std::string_view version() const;
+    std::string_view header(std::string_view key) const; // 请求头，大小写不敏感，没有返回空
+    std::string_view header(HTTP_HEADER id) const;  // 常用请求头，直接按编号取
     std::string getPost(const std::string& key) const; // 获取POST请求的参数
     std::string getPost(const char* key) const; // 获取POST请求的参数
 
     bool isKeepAlive() const;
 
+    static size_t maxHeaderSize;  // 请求行+请求头的上限
+    static size_t maxBodySize;  // 请求体的上限
+
 private:
-    bool parseRequestLine(const std::string& line); // 解析请求行
-    void parseHeader(const std::string& line);   // 解析请求头
-    void parseBody(const std::string& line);    // 解析请求体
+    // 请求行、请求头在缓冲区里的位置，相对于 peek()，parse 保证这一段是连续的
+    struct Slice {
+        uint32_t off = 0;
+        uint32_t len = 0;
+    };
 
-    void parsePath();   // 解析路径
+    bool parseRequestLine(const char* begin, const char* end); // 解析请求行
+    bool parseHeader(const char* begin, const char* end);   // 解析请求头
+    int parseFraming_();  // 请求头收完后确定请求体的长度和编码
+    bool feedBody_(const char* data, size_t len);  // 收到一段请求体
+    HTTP_CODE error_(int code);
+
+    bool parsePath();   // 规范化并解析路径，路径非法（不以 '/' 开头、".." 到了根目录以上）返回 false
     void parsePost();   // 解析POST请求
     void parseFromUrlencoded(); // 解析url编码
 
+    std::string_view view_(const Slice& s) const;
+    Slice slice_(const char* begin, const char* end) const;
+
+    static bool isNormalPath_(std::string_view path);  // 没有 "//"、"." 和 ".." 段
     static bool UserVerify(const std::string& name, const std::string& pwd, bool isLogin);  // 用户验证
     static int ConverHex(char ch);  // 16进制转为10进制
 
     PARSE_STATE m_state;
-    std::string m_method, m_path, m_version, m_body;
-    std::unordered_map<std::string, std::string> m_headers;
+    const Buffer* m_buff;  // 请求所在的读缓冲区
+    size_t m_parsed;  // 已经解析到的位置（相对于 peek()），请求体不算在内
+    size_t m_bodyLeft;  // 当前（分块）请求体还剩多少字节
+    size_t m_bodyLen;  // 已经收到的请求体总长度
+    int m_errorCode;
+    bool m_collectBody;  // 表单请求体要攒下来解析
+    bool m_expectContinue;
+    BodySink m_sink;
+    Slice m_method, m_path, m_version;
+    std::string_view m_pathRewrite;  // parsePath/parsePost 改写后的路径（指向静态字符串），空表示没改写
+    std::string m_normPath;  // 请求路径需要规范化时的结果，空表示缓冲区里的就是规范的
+    std::string m_body;
+    Slice m_known[HDR_COUNT];  // 常用请求头，下标是 HTTP_HEADER
+    uint32_t m_knownMask;  // m_known 里哪些是这个请求的
+    std::vector<std::pair<Slice, Slice>> m_otherHeaders;  // 其他请求头，clear 不释放内存
     std::unordered_map<std::string, std::string> m_post;
-
-    static const std::unordered_set<std::string> DEFAULT_HTML;   // 默认html文件
-    static const std::unordered_map<std::string, int> DEFAULT_HTML_TAG; // 默认html文件标签
 };
 
-#endif // HTTPREQUEST_H
\ No newline at end of file
+#endif // HTTPREQUEST_H
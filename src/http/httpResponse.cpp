@@ -1,6 +1,8 @@
 #include "httpResponse.h"
+#include <charconv>  // to_chars
 
-const std::unordered_map<std::string, std::string> HttpResponse::SUFFIX_TYPE {
+// 文件后缀类型,根据响应的文件类型返回对应的 Content-Type
+static constexpr auto SUFFIX_TYPE = makeStaticMap<std::string_view>({
     {".html", "text/html"},
     {".xml", "text/xml"},
     {".xhtml", "application/xhtml+xml"},
@@ -20,59 +22,479 @@ const std::unordered_map<std::string, std::string> HttpResponse::SUFFIX_TYPE {
     {".tar", "application/x-tar"},
     {".css", "text/css "},
     {".js", "text/javascript "},
-};
+    {".svg", "image/svg+xml"},
+    {".ico", "image/x-icon"},
+    {".mp4", "video/mp4"},
+    {".woff", "font/woff"},
+    {".woff2", "font/woff2"},
+    {".ttf", "font/ttf"},
+    {".otf", "font/otf"},
+    {".eot", "application/vnd.ms-fontobject"},
+});
 
+// 默认的缓存策略：字体、样式、脚本一年且不会变，图片、视频一天，html 每次都要验证（配合 ETag 返回 304）
+static const char* DEFAULT_CACHE_POLICY =
+    ".css:31536000:immutable,.js:31536000:immutable,"
+    ".woff:31536000:immutable,.woff2:31536000:immutable,.ttf:31536000:immutable,"
+    ".otf:31536000:immutable,.eot:31536000:immutable,.svg:31536000:immutable,"
+    ".png:86400,.gif:86400,.jpg:86400,.jpeg:86400,.ico:86400,"
+    ".mp4:86400,.mpeg:86400,.mpg:86400,.avi:86400,"
+    ".html:0,.xhtml:0";
 
-const std::unordered_map<int, std::string> HttpResponse::CODE_STATUS {
-    {200, "OK"},
-    {400, "Bad Request"},    // 400 代表客户端请求的语法错误，服务器无法理解
-    {403, "Forbidden"},
-    {404, "Not Found"},
-};
+// 状态码对应的状态信息和 .html 文件路径
+static constexpr StatusTable CODE_STATUS({
+    {200, "OK", ""},
+    {206, "Partial Content", ""},    // Range 请求，只发一部分
+    {304, "Not Modified", ""},    // 条件请求，客户端缓存的还是最新的
+    {400, "Bad Request", "/400.html"},    // 400 代表客户端请求的语法错误，服务器无法理解
+    {403, "Forbidden", "/403.html"},
+    {404, "Not Found", "/404.html"},
+    {413, "Payload Too Large", ""},    // 请求体超过上限
+    {416, "Range Not Satisfiable", ""},    // Range 超出了文件范围
+    {431, "Request Header Fields Too Large", ""},    // 请求头超过上限
+    {501, "Not Implemented", ""},    // 不支持的 Transfer-Encoding
+});
 
-const std::unordered_map<int, std::string> HttpResponse::CODE_PATH {
-    {400, "/400.html"},
-    {403, "/403.html"},
-    {404, "/404.html"},
+// 状态行启动时拼好，下标是状态码，不认识的为空
+static const std::vector<std::string> STATUS_LINE = [] {
+    std::vector<std::string> lines(600);
+    for (int code = 100; code < 600; code++) {
+        const StatusTable::Status* status = CODE_STATUS.find(code);
+        if (status) {
+            lines[code] = "HTTP/1.1 " + std::to_string(code) + " " + std::string(status->text) + "\r\n";
+        }
+    }
+    return lines;
+}();
+
+// 固定的响应头片段，下标是 HttpEncoding::ENCODING
+static constexpr std::string_view CONTENT_ENCODING[] = {
+    "",
+    "Content-Encoding: gzip\r\n",
+    "Content-Encoding: br\r\n",
 };
 
+// 整数直接格式化进缓冲区，不经过临时的 std::string
+template <typename Out>
+static void appendNum(Out& out, uint64_t n) {
+    char buf[24];
+    char* end = std::to_chars(buf, buf + sizeof(buf), n).ptr;
+    out.append(buf, end - buf);
+}
+
+// "Sun, 06 Nov 1994 08:49:37 GMT"，buf 至少 32 字节，返回长度
+static size_t formatHttpDate(time_t t, char* buf) {
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    return strftime(buf, 32, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+}
+
+static size_t formatETag(const struct stat& st, HttpEncoding::ENCODING encoding, char* buf, size_t size) {
+    int n = snprintf(buf, size, "\"%lx-%lx-%llx%s%s\"", (unsigned long)st.st_ino, (unsigned long)st.st_size,
+                     (unsigned long long)st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec,
+                     encoding == HttpEncoding::IDENTITY ? "" : "-", HttpEncoding::name(encoding).data());
+    return std::min<size_t>(n, size - 1);
+}
+
+size_t HttpResponse::sendfileMin = 16 * 1024;
+std::vector<std::string> HttpResponse::CACHE_CONTROL;
+static bool s_defaultPolicy = HttpResponse::setCachePolicy(DEFAULT_CACHE_POLICY);
+
 HttpResponse::HttpResponse() {
     m_code = -1;
+    m_fileFd = -1;
     m_isKeepAlive = false;
+    m_keepAliveTimeout = m_keepAliveMax = 0;
+    m_accept = HttpEncoding::IDENTITY;
+    m_variant = m_encoding = HttpEncoding::IDENTITY;
+    m_vary = false;
+    m_cacheEpoch = 0;
     m_srcDir = "";
     m_mmFile = nullptr;
     m_mmFileStat = {0};
+    m_archived = nullptr;
 }
 
 HttpResponse::~HttpResponse() {
     unmapFile(); //释放内存映射
 }
 
-void HttpResponse::init(const std::string& srcDir, std::string& path, bool isKeepAlive, int code) {
-    assert(!path.empty());
-    if (m_mmFile) { unmapFile(); }  // 如果之前有映射文件，先释放
+void HttpResponse::init(const std::string& srcDir, std::string_view path, bool isKeepAlive, int code, int acceptEncoding) {
+    unmapFile();  // 如果之前有映射文件，先释放
     m_code = code;
     m_isKeepAlive = isKeepAlive;
-    m_path = path;
+    m_keepAliveTimeout = m_keepAliveMax = 0;
+    m_accept = acceptEncoding;
+    m_variant = m_encoding = HttpEncoding::IDENTITY;
+    m_vary = false;
+    m_ifNoneMatch = m_ifModifiedSince = std::string_view();
+    m_range = m_ifRange = std::string_view();
+    m_segments.clear();
+    m_parts.clear();
+    m_etag.clear();
+    m_lastModified.clear();
+    m_path.assign(path.data(), path.size());
+    if (m_path.empty()) {
+        m_path = "/";  // 请求行都没解析出来的 400 请求
+    }
     m_srcDir = srcDir;
     m_mmFile = nullptr;
     m_mmFileStat = {0};
 }
 
 void HttpResponse::makeResponse(Buffer& buff) {
+    if (HttpArchive::instance()->loaded() && serveArchive_(buff)) {
+        return;
+    }
+    HttpEncoding::ENCODING variant = HttpEncoding::IDENTITY;
+    bool vary = false;
+    if (m_code == -1 || m_code == 200) {
+        // 文本类型按客户端接受的编码选一个，缓存里每种编码各存一份
+        if (HttpEncoding::compressible(getFileType_())) {
+            vary = true;
+            variant = HttpEncoding::choose(m_accept);
+        }
+        // 缓存里有序列化好的响应，直接用，不用 stat/open/mmap
+        m_cached = HttpCache::instance()->get(m_path, variant);
+        if (m_cached) {
+            m_code = 200;
+            m_vary = vary;
+            m_variant = variant;
+            m_encoding = static_cast<HttpEncoding::ENCODING>(m_cached->encoding);
+            if (notModified_(m_cached->etag, m_cached->lastModified, m_cached->mtime)) {
+                addNotModified_(buff, m_cached->etag, m_cached->lastModified);
+            } else {
+                addBody_(buff);
+            }
+            return;
+        }
+    }
+    m_cacheEpoch = HttpCache::instance()->epoch();  // 在 stat 之前取，之后文件变了就不会把旧内容放进缓存
+    m_file = m_srcDir + m_path;
     // 判断请求的资源文件是否存在
-    // stat() 用于获取文件的属性，存储在 m_mmFileStat 中 ，后面是是检查是否是目录
-    if (stat((m_srcDir + m_path).data(), &m_mmFileStat) < 0 || S_ISDIR(m_mmFileStat.st_mode)) {
+    // 文件的属性从打开文件缓存里取，存储在 m_mmFileStat 中 ，后面是是检查是否是目录
+    if (m_code >= 400) {
+        // 请求本身有错，不用去找请求的文件
+    } else if (!openStat_() || S_ISDIR(m_mmFileStat.st_mode)) {
         m_code = 404;
     } else if (!(m_mmFileStat.st_mode & S_IROTH)) {
         m_code = 403;                     // 检查文件是否对他人可读 ，S_IROTH 是个宏，表示其他人可读的权限位，设置了即可读
     } else if (m_code == -1) {
         m_code = 200;
     }
+    const StatusTable::Status* status = CODE_STATUS.find(m_code);
+    if (m_code >= 400 && status && status->page.empty()) {
+        // 没有对应错误页面的状态码，直接生成一个简单的 html
+        m_mmFileStat = {0};
+        m_isKeepAlive = false;
+        addStateLine_(buff);
+        buff.append("Content-type: text/html\r\n");
+        errorContent(buff, std::string(status->text));
+        return;
+    }
+    if (m_code == 200) {
+        m_vary = vary;
+        m_variant = m_encoding = variant;
+        if (m_encoding != HttpEncoding::IDENTITY && encode_()) {
+            // 压缩好的内容已经在缓存条目里了
+            if (notModified_(m_etag, m_lastModified, m_mmFileStat.st_mtime)) {
+                addNotModified_(buff, m_etag, m_lastModified);
+            } else {
+                addBody_(buff);
+            }
+            return;
+        }
+        makeValidators_();
+        if (notModified_(m_etag, m_lastModified, m_mmFileStat.st_mtime)) {
+            addNotModified_(buff, m_etag, m_lastModified);
+            return;
+        }
+    }
     errorHtml_();  // 生成错误响应报文的 HTML 内容
+    if (!openFile_()) {
+        addStateLine_(buff);
+        addHeader_(buff);
+        errorContent(buff, "File NotFound!");
+        return;
+    }
+    if (m_code == 200 && HttpCache::instance()->enabled() && fileLen() <= HttpCache::instance()->maxObjectSize()) {
+        fillCache_();  // 放进缓存之后从缓存条目发
+    }
+    addBody_(buff);
+}
+
+// 资源包模式：内容、类型、ETag 都在包里，整个过程不碰文件系统。
+// 包里没有的路径是 404；包里连错误页面都没有时返回 false，走下面从文件生成的流程
+bool HttpResponse::serveArchive_(Buffer& buff) {
+    const HttpArchive* archive = HttpArchive::instance();
+    const HttpArchive::File* file = nullptr;
+    if (m_code == -1 || m_code == 200) {
+        file = archive->find(m_path);
+        m_code = file ? 200 : 404;
+    }
+    if (!file) {
+        const StatusTable::Status* status = CODE_STATUS.find(m_code);
+        if (!status || status->page.empty() || !(file = archive->find(status->page))) {
+            return false;
+        }
+        m_path = status->page;
+    }
+    m_archived = file;
+    HttpEncoding::ENCODING encoding = HttpEncoding::IDENTITY;
+    if (m_code == 200 && HttpEncoding::compressible(file->type)) {
+        m_vary = true;
+        encoding = HttpEncoding::choose(m_accept & file->encodings);  // 只在包里有的版本里选
+    }
+    const HttpArchive::Content& content = file->variants[encoding];
+    m_encoding = encoding;
+    m_mmFileStat.st_size = content.len;
+    m_mmFileStat.st_mtime = file->mtime;
+    if (m_code == 200) {
+        m_etag.assign(content.etag.data(), content.etag.size());
+        m_lastModified.assign(file->lastModified.data(), file->lastModified.size());
+        if (notModified_(m_etag, m_lastModified, file->mtime)) {
+            addNotModified_(buff, m_etag, m_lastModified);
+            return true;
+        }
+    }
+    addBody_(buff);
+    return true;
+}
+
+// 响应头和响应体：200 的请求带了 Range 就只发请求的部分，否则发整个内容
+// 内容在缓存条目、映射区或者打开的文件里
+void HttpResponse::addBody_(Buffer& buff) {
+    const char* data = m_cached ? m_cached->body.data() : m_archived ? m_archived->variants[m_encoding].data : m_mmFile;
+    size_t size = m_cached ? m_cached->body.size() : fileLen();
+    if (m_code == 200 && !m_range.empty() && addRanges_(buff, data, size)) {
+        return;
+    }
+    if (m_cached) {
+        // 状态行后面的响应头都是序列化好的，buff 里只写状态行和 Date
+        const std::string& header = m_cached->header;
+        addStateLine_(buff);
+        addSegment_(header.data(), 0, header.size());
+        addSegment_(data, 0, size);
+        return;
+    }
     addStateLine_(buff);  //添加状态行
     addHeader_(buff);    //添加响应头
-    addContent_(buff);   //添加响应体，此时内容在 m_mmFile 中
+    addContentLength_(buff, size);
+    addSegment_(data, 0, size);
+}
+
+// base 为空表示文件段，由 sendfile 从 offset 开始发
+void HttpResponse::addSegment_(const char* base, off_t offset, size_t len) {
+    if (len > 0) {
+        m_segments.push_back({base ? base + offset : nullptr, offset, len});
+    }
+}
+
+// Range: bytes=0-499,1000-,-500
+// 语法不对、范围太多、If-Range 不匹配都返回 false，当作没有 Range 发整个内容
+bool HttpResponse::addRanges_(Buffer& buff, const char* data, size_t size) {
+    if (m_cached && m_etag.empty()) {
+        m_etag = m_cached->etag;
+        m_lastModified = m_cached->lastModified;
+    }
+    // If-Range 是 ETag 时要强比较，是日期时要和 Last-Modified 完全一致
+    if (!m_ifRange.empty() && m_ifRange != m_etag && m_ifRange != m_lastModified) {
+        return false;
+    }
+    std::string_view spec = m_range;
+    if (spec.substr(0, 6) != "bytes=") {
+        return false;
+    }
+    spec.remove_prefix(6);
+    std::vector<std::pair<size_t, size_t>> ranges;  // [first, last]
+    bool any = false;
+    while (!spec.empty()) {
+        size_t comma = spec.find(',');
+        std::string_view item = spec.substr(0, comma);
+        spec = comma == std::string_view::npos ? std::string_view() : spec.substr(comma + 1);
+        while (!item.empty() && (item.front() == ' ' || item.front() == '\t')) item.remove_prefix(1);
+        while (!item.empty() && (item.back() == ' ' || item.back() == '\t')) item.remove_suffix(1);
+        size_t dash = item.find('-');
+        if (dash == std::string_view::npos || ranges.size() >= MAX_RANGES) {
+            return false;
+        }
+        size_t first = 0, last = 0;
+        bool hasFirst = parseNum_(item.substr(0, dash), &first);
+        bool hasLast = parseNum_(item.substr(dash + 1), &last);
+        if ((!hasFirst && dash != 0) || (!hasLast && dash + 1 != item.size()) || (!hasFirst && !hasLast)) {
+            return false;
+        }
+        if (!hasFirst) {
+            // -500：最后 500 个字节
+            if (last == 0 || size == 0) {
+                continue;
+            }
+            first = size - std::min(last, size);
+            last = size - 1;
+        } else {
+            if (hasLast && last < first) {
+                return false;
+            }
+            if (first >= size) {
+                continue;  // 这一段不可满足
+            }
+            last = hasLast ? std::min(last, size - 1) : size - 1;
+        }
+        ranges.emplace_back(first, last);
+        any = true;
+    }
+    if (!any) {
+        // 没有一段落在文件里
+        m_code = 416;
+        m_cached.reset();
+        addStateLine_(buff);
+        buff.append("Content-Range: bytes */");
+        appendNum(buff, size);
+        buff.append("\r\nContent-length: 0\r\n\r\n");
+        return true;
+    }
+    m_code = 206;
+    addStateLine_(buff);
+    if (ranges.size() == 1) {
+        size_t first = ranges[0].first, last = ranges[0].second;
+        addHeader_(buff);
+        buff.append("Content-Range: bytes ");
+        appendNum(buff, first);
+        buff.append("-");
+        appendNum(buff, last);
+        buff.append("/");
+        appendNum(buff, size);
+        buff.append("\r\n");
+        addContentLength_(buff, last - first + 1);
+        addSegment_(data, first, last - first + 1);
+        return true;
+    }
+    // 多段：multipart/byteranges，每段前面一个小头，分隔头都放在 m_parts 里，最后统一转成分段
+    std::string_view type = getFileType_();
+    std::vector<size_t> partEnd;
+    for (auto& r : ranges) {
+        m_parts += "\r\n--";
+        m_parts += BOUNDARY;
+        m_parts += "\r\nContent-Type: ";
+        m_parts.append(type.data(), type.size());
+        m_parts += "\r\nContent-Range: bytes ";
+        appendNum(m_parts, r.first);
+        m_parts += "-";
+        appendNum(m_parts, r.second);
+        m_parts += "/";
+        appendNum(m_parts, size);
+        m_parts += "\r\n\r\n";
+        partEnd.push_back(m_parts.size());
+    }
+    m_parts += "\r\n--";
+    m_parts += BOUNDARY;
+    m_parts += "--\r\n";
+    size_t total = m_parts.size();
+    size_t begin = 0;
+    for (size_t i = 0; i < ranges.size(); i++) {
+        addSegment_(m_parts.data(), begin, partEnd[i] - begin);
+        addSegment_(data, ranges[i].first, ranges[i].second - ranges[i].first + 1);
+        total += ranges[i].second - ranges[i].first + 1;
+        begin = partEnd[i];
+    }
+    addSegment_(m_parts.data(), begin, m_parts.size() - begin);
+    static const std::string multipartType = std::string("multipart/byteranges; boundary=") + BOUNDARY;
+    addHeader_(buff, multipartType);
+    addContentLength_(buff, total);
+    return true;
+}
+
+bool HttpResponse::parseNum_(std::string_view str, size_t* num) {
+    if (str.empty() || str.size() > 18) {
+        return false;
+    }
+    size_t n = 0;
+    for (char ch : str) {
+        if (ch < '0' || ch > '9') {
+            return false;
+        }
+        n = n * 10 + (ch - '0');
+    }
+    *num = n;
+    return true;
+}
+
+// 选好了编码：有预压缩的文件（xxx.css.br / xxx.css.gz）就直接发它，
+// 否则读出来压缩一次放进缓存。返回 true 表示响应已经在 m_cached 里了
+bool HttpResponse::encode_() {
+    std::string sibling = m_file;
+    sibling.append(HttpEncoding::suffix(m_encoding));
+    // 没有预压缩文件也会留一个负缓存，下次不用再 stat
+    HttpOpenFilePtr sib = HttpFileCache::instance()->open(sibling);
+    if (!sib->err && S_ISREG(sib->st.st_mode) && (sib->st.st_mode & S_IROTH)) {
+        m_file.swap(sibling);
+        m_open = sib;
+        m_mmFileStat = sib->st;
+        return false;  // 当普通文件发，Content-Encoding 在 addHeader_ 里加
+    }
+    HttpCache* cache = HttpCache::instance();
+    size_t len = fileLen();
+    if (!cache->enabled() || len > cache->maxObjectSize() || len < HttpEncoding::MIN_SIZE) {
+        // 压缩的结果没地方存，或者文件太小不值得压缩，不压缩发
+        // 不压缩的版本照样缓存在这个编码下，下次直接命中
+        m_encoding = HttpEncoding::IDENTITY;
+        return false;
+    }
+    if (m_open->fd < 0) {
+        m_encoding = HttpEncoding::IDENTITY;
+        return false;
+    }
+    if (!cache->beginFill(m_path, m_variant)) {
+        // 别的线程正在压缩同一个文件，这次发原文，按不压缩的变体缓存，不占压缩变体的位置
+        m_variant = m_encoding = HttpEncoding::IDENTITY;
+        return false;
+    }
+    std::string raw(len, '\0');
+    std::string body;
+    bool ok = pread(m_open->fd, &raw[0], len, 0) == (ssize_t)len;
+    if (!ok || !HttpEncoding::compress(m_encoding, raw.data(), len, body) || body.size() >= len) {
+        m_encoding = HttpEncoding::IDENTITY;  // 压缩了反而更大就发原文
+        body.swap(raw);
+    }
+    LOG_DEBUG("compress %s: %zu -> %zu (%s)", m_path.data(), len, body.size(), HttpEncoding::name(m_encoding).data());
+    makeValidators_();
+    m_cached = cacheEntry_(std::move(body));
+    cache->endFill(m_path, m_variant);  // 放进缓存之后再放开，之后的请求直接命中
+    return true;
+}
+
+// 刚打开的 200 响应放进缓存，之后从缓存条目发，文件可以关掉了
+void HttpResponse::fillCache_() {
+    std::string body;
+    if (m_mmFile) {
+        body.assign(m_mmFile, m_mmFileStat.st_size);
+    } else if (m_fileFd >= 0) {
+        // 走 sendfile 的文件没有映射，读一份进缓存
+        body.resize(m_mmFileStat.st_size);
+        if (pread(m_fileFd, &body[0], body.size(), 0) != (ssize_t)body.size()) {
+            return;
+        }
+    }
+    HttpCacheEntryPtr entry = cacheEntry_(std::move(body));
+    unmapFile();
+    m_cached = entry;
+}
+
+// 响应头生成好，和内容一起放进缓存，key 是路径加上客户端要的编码
+// 状态行、Date 和 Connection 每个连接不一样，每次发送时再加
+HttpCacheEntryPtr HttpResponse::cacheEntry_(std::string body) {
+    std::shared_ptr<HttpCacheEntry> entry = std::make_shared<HttpCacheEntry>();
+    Buffer tmp;
+    addHeader_(tmp);
+    addContentLength_(tmp, body.size());
+    entry->header = tmp.retrieveAllToStr();
+    entry->body = std::move(body);
+    entry->etag = m_etag;
+    entry->lastModified = m_lastModified;
+    entry->mtime = m_mmFileStat.st_mtime;
+    entry->encoding = m_encoding;
+    HttpCache::instance()->put(m_path, entry, m_variant, m_cacheEpoch);
+    return entry;
 }
 
 char* HttpResponse::file() {
@@ -84,88 +506,322 @@ size_t HttpResponse::fileLen() const {
 }
 
 void HttpResponse::errorHtml_() {
-    if (CODE_PATH.count(m_code) == 1) {
-        m_path = CODE_PATH.find(m_code)->second;
-        stat((m_srcDir + m_path).data(), &m_mmFileStat); // 获取错误文件的属性
+    const StatusTable::Status* status = CODE_STATUS.find(m_code);
+    if (status && !status->page.empty()) {
+        m_path = status->page;
+        m_file = m_srcDir + m_path;
+        openStat_(); // 获取错误文件的属性
+    }
+}
+
+// 从打开文件缓存里取 m_file 的 fd 和属性，文件不存在返回 false
+bool HttpResponse::openStat_() {
+    m_open = HttpFileCache::instance()->open(m_file);
+    if (m_open->err) {
+        m_mmFileStat = {0};
+        return false;
     }
+    m_mmFileStat = m_open->st;
+    return true;
 }
 
 void HttpResponse::addStateLine_(Buffer& buff) {
-    std::string status;  // 只有 200 400 需要处理
-    if (CODE_STATUS.count(m_code) == 1) {
-        status = CODE_STATUS.find(m_code)->second;
-    } else {
+    const StatusTable::Status* status = CODE_STATUS.find(m_code);
+    if (!status) {
         m_code = 400;
-        status = CODE_STATUS.find(400)->second;
+        status = CODE_STATUS.find(400);
+    }
+    buff.append(STATUS_LINE[m_code]);
+    addDate_(buff);  // 每个响应都要带（RFC 7231 7.1.1.2）
+    addConnection_(buff);
+}
+
+// Date 每秒只格式化一次，每个线程一份，不用加锁
+void HttpResponse::addDate_(Buffer& buff) {
+    thread_local time_t cachedSec = -1;
+    thread_local char line[48];
+    thread_local size_t len = 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    if (ts.tv_sec != cachedSec) {
+        memcpy(line, "Date: ", 6);
+        len = 6 + formatHttpDate(ts.tv_sec, line + 6);
+        memcpy(line + len, "\r\n", 2);
+        len += 2;
+        cachedSec = ts.tv_sec;
+    }
+    buff.append(line, len);
+}
+
+void HttpResponse::addContentLength_(Buffer& buff, size_t len) {
+    buff.append("Content-length: ");
+    appendNum(buff, len);
+    buff.append("\r\n\r\n");
+}
+
+// Keep-Alive 的值是服务器实际执行的：空闲多少秒关连接，这个连接还能再处理几个请求
+void HttpResponse::addConnection_(Buffer& buff) {
+    if (!m_isKeepAlive) {
+        buff.append("Connection: close\r\n");
+        return;
+    }
+    buff.append("Connection: keep-alive\r\n");
+    if (m_keepAliveTimeout <= 0 && m_keepAliveMax <= 0) {
+        return;
+    }
+    buff.append("Keep-Alive: ");
+    if (m_keepAliveTimeout > 0) {
+        buff.append("timeout=");
+        appendNum(buff, m_keepAliveTimeout);
+        if (m_keepAliveMax > 0) {
+            buff.append(", ");
+        }
     }
-    buff.append("HTTP/1.1 " + std::to_string(m_code) + " " + status + "\r\n");
+    if (m_keepAliveMax > 0) {
+        buff.append("max=");
+        appendNum(buff, m_keepAliveMax);
+    }
+    buff.append("\r\n");
+}
+
+void HttpResponse::setKeepAlive(int timeout, int max) {
+    m_keepAliveTimeout = timeout;
+    m_keepAliveMax = max;
 }
 
 void HttpResponse::addHeader_(Buffer& buff) {
-    buff.append("Connection: ");
-    if (m_isKeepAlive) {
-        buff.append("keep-alive\r\n");
-        buff.append("keep-alive: max=6, timeout=120\r\n");
-    } else {
-        buff.append("close\r\n");
+    addHeader_(buff, getFileType_());
+}
+
+void HttpResponse::addHeader_(Buffer& buff, std::string_view type) {
+    buff.append("Content-type: ");
+    buff.append(type.data(), type.size());
+    buff.append("\r\n");
+    addCacheControl_(buff);
+    if (m_vary) {
+        buff.append("Vary: Accept-Encoding\r\n");  // 同一个路径的响应会因 Accept-Encoding 不同，告诉中间缓存
+    }
+    buff.append(CONTENT_ENCODING[m_encoding]);
+    if (!m_etag.empty()) {
+        addValidators_(buff, m_etag, m_lastModified);
+        buff.append("Accept-Ranges: bytes\r\n");
+    }
+}
+
+void HttpResponse::addValidators_(Buffer& buff, std::string_view etag, std::string_view lastModified) {
+    buff.append("ETag: ");
+    buff.append(etag.data(), etag.size());
+    buff.append("\r\nLast-Modified: ");
+    buff.append(lastModified.data(), lastModified.size());
+    buff.append("\r\n");
+}
+
+void HttpResponse::setConditional(std::string_view ifNoneMatch, std::string_view ifModifiedSince) {
+    m_ifNoneMatch = ifNoneMatch;
+    m_ifModifiedSince = ifModifiedSince;
+}
+
+void HttpResponse::setRange(std::string_view range, std::string_view ifRange) {
+    m_range = range;
+    m_ifRange = ifRange;
+}
+
+// ETag 由 inode、大小、修改时间（纳秒）拼出来，文件一变就不同；不同编码的内容不一样，ETag 也要区分
+// 格式化到栈上再 assign，m_etag/m_lastModified 的容量在请求之间复用，不会重新分配
+void HttpResponse::makeValidators_() {
+    char buf[80];
+    m_etag.assign(buf, formatETag(m_mmFileStat, m_encoding, buf, sizeof(buf)));
+    m_lastModified.assign(buf, formatHttpDate(m_mmFileStat.st_mtime, buf));
+}
+
+std::string HttpResponse::makeETag(const struct stat& st, HttpEncoding::ENCODING encoding) {
+    char buf[80];
+    return std::string(buf, formatETag(st, encoding, buf, sizeof(buf)));
+}
+
+// RFC 7232：有 If-None-Match 就只看它（弱比较），否则看 If-Modified-Since
+bool HttpResponse::notModified_(std::string_view etag, std::string_view lastModified, time_t mtime) const {
+    if (!m_ifNoneMatch.empty()) {
+        std::string_view list = m_ifNoneMatch;
+        while (!list.empty()) {
+            size_t comma = list.find(',');
+            std::string_view tag = list.substr(0, comma);
+            list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+            while (!tag.empty() && (tag.front() == ' ' || tag.front() == '\t')) tag.remove_prefix(1);
+            while (!tag.empty() && (tag.back() == ' ' || tag.back() == '\t')) tag.remove_suffix(1);
+            if (tag.substr(0, 2) == "W/") {
+                tag.remove_prefix(2);
+            }
+            if (tag == "*" || tag == etag) {
+                return true;
+            }
+        }
+        return false;
+    }
+    if (m_ifModifiedSince.empty()) {
+        return false;
+    }
+    // 浏览器一般原样带回我们发的 Last-Modified，先直接比字符串，省掉解析
+    if (m_ifModifiedSince == lastModified) {
+        return true;
+    }
+    time_t since;
+    return parseHttpDate(m_ifModifiedSince, &since) && mtime <= since;
+}
+
+// 304 只有状态行和校验信息，没有响应体
+void HttpResponse::addNotModified_(Buffer& buff, std::string_view etag, std::string_view lastModified) {
+    m_code = 304;
+    m_cached.reset();
+    m_mmFileStat.st_size = 0;
+    addStateLine_(buff);
+    if (m_vary) {
+        buff.append("Vary: Accept-Encoding\r\n");
     }
-    buff.append("Content-type: " + getFileType_() + "\r\n");
+    addCacheControl_(buff);  // 304 也要带上，客户端据此刷新缓存的有效期
+    addValidators_(buff, etag, lastModified);
+    buff.append("\r\n");
 }
 
-void HttpResponse::addContent_(Buffer& buff) {
-    int srcFd = open((m_srcDir + m_path).data(), O_RDONLY);  // 只读方式打开文件
+// "Sun, 06 Nov 1994 08:49:37 GMT"
+std::string HttpResponse::httpDate(time_t t) {
+    char buf[32];
+    return std::string(buf, formatHttpDate(t, buf));
+}
+
+bool HttpResponse::parseHttpDate(std::string_view str, time_t* t) {
+    char buf[64];
+    if (str.size() >= sizeof(buf)) {
+        return false;
+    }
+    memcpy(buf, str.data(), str.size());
+    buf[str.size()] = '\0';
+    struct tm tm = {};
+    const char* end = strptime(buf, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if (!end || *end != '\0') {
+        return false;
+    }
+    *t = timegm(&tm);
+    return true;
+}
+
+// 打开要发送的文件：大文件留着 fd，小文件映射到内存
+// fd 是打开文件缓存里的，不用自己 open/close，m_open 持有期间一直有效
+bool HttpResponse::openFile_() {
+    int srcFd = m_open ? m_open->fd : -1;
     // -1 表示打开失败
     if (srcFd < 0) {
-        errorContent(buff, "File NotFound!");
-        return;
+        m_mmFileStat.st_size = 0;
+        return false;
     }
-    ////将文件映射到内存提高文件的访问速度  MAP_PRIVATE 建立一个写入时拷贝的私有映射
-    LOG_DEBUG("file path %s", (m_srcDir + m_path).data());
-    int* mmRet = (int*)mmap(0, m_mmFileStat.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
-    if (*mmRet == -1) {
-        errorContent(buff, "File NotFound!");
-        return;
+    LOG_DEBUG("file path %s", m_file.data());
+    if (static_cast<size_t>(m_mmFileStat.st_size) >= sendfileMin) {
+        // 大文件留着 fd 给 sendfile，不经过用户态，也没有缺页
+        m_fileFd = srcFd;
+    } else if (m_mmFileStat.st_size > 0) {
+        ////将文件映射到内存提高文件的访问速度  MAP_PRIVATE 建立一个写入时拷贝的私有映射
+        void* mmRet = mmap(0, m_mmFileStat.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
+        if (mmRet == MAP_FAILED) {
+            m_mmFileStat.st_size = 0;
+            return false;
+        }
+        m_mmFile = (char*)mmRet;  // 返回映射文件的指针
     }
-    m_mmFile = (char*)mmRet;  // 返回映射文件的指针
-    close(srcFd);  // 关闭文件
-    buff.append("Content-length: " + std::to_string(m_mmFileStat.st_size) + "\r\n\r\n");
+    return true;
 }
 
 void HttpResponse::unmapFile() {
+    m_segments.clear();
+    m_cached.reset();
+    m_archived = nullptr;
+    m_fileFd = -1;
+    m_open.reset();  // 最后一个引用放掉时 fd 才关闭
     if (m_mmFile) {
         munmap(m_mmFile, m_mmFileStat.st_size);
         m_mmFile = nullptr;  
     }
 }
 
-std::string HttpResponse::getFileType_() {
-    std::string::size_type idx = m_path.find_last_of('.');  // 找到文件名中最后一个 . 的位置
+// 后缀在 SUFFIX_TYPE 里的下标，不认识的后缀返回 -1
+int HttpResponse::suffixIndex_(std::string_view path) {
+    std::string::size_type idx = path.find_last_of('.');  // 找到文件名中最后一个 . 的位置
     if (idx == std::string::npos) {
-        return "text/plain";
+        return -1;
     }
-    std::string suffix = m_path.substr(idx);  // 获取文件后缀
-    if (SUFFIX_TYPE.count(suffix) == 1) {
-        return SUFFIX_TYPE.find(suffix)->second;
+    // 后缀直接在路径上取视图，查表不用构造字符串
+    return SUFFIX_TYPE.indexOf(path.substr(idx));
+}
+
+std::string_view HttpResponse::fileType(std::string_view path) {
+    int idx = suffixIndex_(path);
+    if (idx >= 0) {
+        return SUFFIX_TYPE[idx].value;
     }
     return "text/plain";  // text/plain 是默认的文件类型,纯文本文件
 }
 
+std::string_view HttpResponse::getFileType_() {
+    if (m_archived) {
+        return m_archived->type;  // 打包时就确定了
+    }
+    return fileType(m_path);
+}
+
+// 成功的响应才带缓存策略，错误页面不让客户端缓存
+void HttpResponse::addCacheControl_(Buffer& buff) {
+    if (m_code != 200 && m_code != 206 && m_code != 304) {
+        return;
+    }
+    int idx = suffixIndex_(m_path);
+    if (idx >= 0 && !CACHE_CONTROL[idx].empty()) {
+        buff.append(CACHE_CONTROL[idx]);
+    }
+}
+
+// 每个后缀的 Cache-Control 头在这里一次拼好，生成响应时直接追加
+// spec 形如 ".css:31536000:immutable,.html:0"，秒数为 0 表示 no-cache（每次验证），-1 表示 no-store；
+// 后面的覆盖前面的，后缀必须在 SUFFIX_TYPE 里
+bool HttpResponse::setCachePolicy(std::string_view spec) {
+    CACHE_CONTROL.resize(SUFFIX_TYPE.size());
+    bool ok = true;
+    while (!spec.empty()) {
+        size_t comma = spec.find(',');
+        std::string_view item = spec.substr(0, comma);
+        spec = comma == std::string_view::npos ? std::string_view() : spec.substr(comma + 1);
+        size_t c1 = item.find(':');
+        int idx = SUFFIX_TYPE.indexOf(item.substr(0, c1));
+        if (c1 == std::string_view::npos || idx < 0) {
+            ok = false;
+            continue;
+        }
+        std::string_view rest = item.substr(c1 + 1);
+        size_t c2 = rest.find(':');
+        bool immutable = c2 != std::string_view::npos && rest.substr(c2 + 1) == "immutable";
+        long maxAge = strtol(std::string(rest.substr(0, c2)).c_str(), nullptr, 10);
+        std::string& header = CACHE_CONTROL[idx];
+        if (maxAge < 0) {
+            header = "Cache-Control: no-store\r\n";
+        } else if (maxAge == 0) {
+            header = "Cache-Control: no-cache\r\n";
+        } else {
+            header = "Cache-Control: public, max-age=" + std::to_string(maxAge) + (immutable ? ", immutable" : "") + "\r\n";
+        }
+    }
+    return ok;
+}
+
 // 把错误信息写入到 buff 中，其实就是 File NotFound! 的 html 内容
 void HttpResponse::errorContent(Buffer& buff, std::string message) {
     std::string body;
-    std::string status;
-    if (CODE_STATUS.count(m_code) == 1) {
-        status = CODE_STATUS.find(m_code)->second;
-    } else {
-        status = "Bad Request";
-    }
+    const StatusTable::Status* code = CODE_STATUS.find(m_code);
+    std::string status = code ? std::string(code->text) : "Bad Request";
     body += "<html><title>Error</title>";
     body += "<body bgcolor=\"ffffff\">";
     body += std::to_string(m_code) + " : " + status + "\n";
     body += "<p>" + message + "</p>";
     body += "<hr><em>WebServer</em></body></html>";
 
-    buff.append("Content-length: " + std::to_string(body.size()) + "\r\n\r\n");
+    addContentLength_(buff, body.size());
     buff.append(body);
 }
 
@@ -2,13 +2,22 @@
 #define HTTPRESPONSE_H
 
 #include <unordered_map>
+#include <string_view>
 #include <fcntl.h> //用于文件描述符的操作
 #include <unistd.h> //用于对文件描述符 API 的操作
 #include <sys/stat.h> //用于文件状态的操作
 #include <sys/mman.h> //用于内存映射
+#include <time.h> // strftime, strptime, timegm
+#include <string.h> // memcpy
+#include <vector>
 
 #include "../buffer/buffer.h"
 #include "../log/log.h"
+#include "httpTables.h"
+#include "httpCache.h"
+#include "httpFileCache.h"
+#include "httpEncoding.h"
+#include "httpArchive.h"
 
 class HttpResponse {
 
@@ -16,38 +25,100 @@ public:
     HttpResponse();
     ~HttpResponse();
 
-    void init(const std::string& srcDir, std::string& path, bool isKeepAlive = false, int code = -1);
+    // acceptEncoding: 客户端接受的内容编码，HttpEncoding::parseAccept 的结果
+    void init(const std::string& srcDir, std::string_view path, bool isKeepAlive = false, int code = -1,
+              int acceptEncoding = HttpEncoding::IDENTITY);
     //生成响应报文，写入到 buff 中
     void makeResponse(Buffer& buff);  
-    //释放内存映射
+    //释放内存映射、打开的文件和缓存条目
     void unmapFile();  
-    // 返回映射文件的指针
+    // 返回映射文件的指针，大文件不映射，返回空
     char* file();   
+    // 大文件用 sendfile 发送，返回打开的文件描述符，没有返回 -1
+    int fileFd() const { return m_fileFd; }
     // 返回映射文件的长度
     size_t fileLen() const;  
     // 生成错误响应报文，并写入buff中
     void errorContent(Buffer& buff, std::string message);  
+    // 条件请求：If-None-Match / If-Modified-Since，只在 makeResponse 里用，调用方保证这期间有效
+    void setConditional(std::string_view ifNoneMatch, std::string_view ifModifiedSince);
+    // Range / If-Range，同上
+    void setRange(std::string_view range, std::string_view ifRange);
+    // 写进 Keep-Alive 头的空闲超时（秒）和剩余请求数，0 表示不写
+    void setKeepAlive(int timeout, int max);
     // 返回状态码
     int code() const { return m_code; }  
+    bool isKeepAlive() const { return m_isKeepAlive; }
+
+    // 响应头（makeResponse 写进 buff 的部分）之后要按顺序发送的内容
+    // data 非空是内存（映射区、缓存条目、multipart 的分隔头），为空是 fileFd() 从 offset 开始的一段
+    struct Segment {
+        const char* data;
+        off_t offset;
+        size_t len;
+    };
+    const std::vector<Segment>& segments() const { return m_segments; }
 private:
     //添加状态行
-    void addStateLine_(Buffer& buff); 
+    void addStateLine_(Buffer& buff);  // 状态行、Date 和 Connection
+    static void addDate_(Buffer& buff);
+    static void addContentLength_(Buffer& buff, size_t len);  // 最后一个响应头，带上空行
     //添加响应头
+    void addConnection_(Buffer& buff);
     void addHeader_(Buffer& buff);   
-    //添加响应体
-    void addContent_(Buffer& buff);  
+    // ETag、Last-Modified
+    void makeValidators_();
+    void addValidators_(Buffer& buff, std::string_view etag, std::string_view lastModified);
+    bool notModified_(std::string_view etag, std::string_view lastModified, time_t mtime) const;
+    void addNotModified_(Buffer& buff, std::string_view etag, std::string_view lastModified);
+    void addHeader_(Buffer& buff, std::string_view type);
+    // 打开文件，添加响应体
+    bool serveArchive_(Buffer& buff);
+    bool openStat_();
+    bool openFile_();
+    void addBody_(Buffer& buff);
+    void addSegment_(const char* base, off_t offset, size_t len);
+    // Range 请求，生成 206/416
+    bool addRanges_(Buffer& buff, const char* data, size_t size);
+    static bool parseNum_(std::string_view str, size_t* num);
     // 生成错误响应报文的 HTML 内容
     void errorHtml_();   
     // 获取文件类型
-    std::string getFileType_();  
+    static int suffixIndex_(std::string_view path);
+    std::string_view getFileType_();  
+    void addCacheControl_(Buffer& buff);
+    // 把刚生成的 200 响应放进缓存
+    void fillCache_();
+    // 内容编码：预压缩文件或者压缩后放进缓存
+    bool encode_();
+    HttpCacheEntryPtr cacheEntry_(std::string body);
 
     // 状态码
     int m_code;  
     // 是否保持连接
     bool m_isKeepAlive;  
+    int m_keepAliveTimeout;
+    int m_keepAliveMax;
 
     // 请求路径
     std::string m_path;     
+    // 实际要发送的文件（资源目录 + 路径，可能是预压缩的 .br/.gz）
+    std::string m_file;
+    int m_accept;  // 客户端接受的编码
+    HttpEncoding::ENCODING m_variant;  // 按 Accept-Encoding 选中的编码，也是缓存的 key
+    HttpEncoding::ENCODING m_encoding;  // 实际发出去的编码，文件太小等情况下退回不压缩
+    bool m_vary;  // 可压缩的类型，响应要带 Vary
+    std::string_view m_ifNoneMatch;
+    std::string_view m_ifModifiedSince;
+    std::string m_etag;  // 200 响应的 ETag，空表示不带校验信息
+    std::string m_lastModified;
+    std::string_view m_range;
+    std::string_view m_ifRange;
+    std::vector<Segment> m_segments;
+    std::string m_parts;  // multipart/byteranges 各段的分隔头
+
+    static const size_t MAX_RANGES = 16;  // 超过的当作没有 Range，防止用大量小范围放大流量
+    static constexpr const char* BOUNDARY = "WEBSERVER_BYTERANGES_7f3a9c21";
     // 资源目录
     std::string m_srcDir;  
 
@@ -55,13 +126,29 @@ private:
     char* m_mmFile;    
     // 映射文件状态
     struct stat m_mmFileStat;  
+    // 命中的缓存条目，发送完之前一直持有
+    HttpCacheEntryPtr m_cached;
+    uint64_t m_cacheEpoch;  // 开始读文件前缓存的 epoch
+    // 要用 sendfile 发送的文件，发送完之前一直打开
+    int m_fileFd;
+    HttpOpenFilePtr m_open;  // 要发送的文件，来自打开文件缓存
+    const HttpArchive::File* m_archived;  // 从资源包发送的文件
 
-    // 文件后缀类型,根据响应的文件类型返回对应的 Content-Type
-    static const std::unordered_map<std::string, std::string> SUFFIX_TYPE;  
-    // 状态码对应的状态信息
-    static const std::unordered_map<int, std::string> CODE_STATUS;   
-    // 状态码对应的 .html 文件路径
-    static const std::unordered_map<int, std::string> CODE_PATH;   
+public:
+    // HTTP 日期格式（RFC 7231 IMF-fixdate）
+    static std::string httpDate(time_t t);
+    static bool parseHttpDate(std::string_view str, time_t* t);
+    // 按后缀的 MIME 类型，不认识的是 text/plain
+    static std::string_view fileType(std::string_view path);
+    // 由 inode、大小、修改时间和内容编码生成，packassets 打包时用同一个函数，两种模式下 ETag 一致
+    static std::string makeETag(const struct stat& st, HttpEncoding::ENCODING encoding);
+    // 不小于这个大小的文件用 sendfile 发，更小的 mmap 之后和响应头一起 writev
+    static size_t sendfileMin;
+    // 按后缀设置缓存策略，".css:31536000:immutable,.html:0"，0 为 no-cache，-1 为 no-store；有不认识的后缀返回 false
+    static bool setCachePolicy(std::string_view spec);
+
+private:
+    static std::vector<std::string> CACHE_CONTROL;  // 每个后缀的 Cache-Control 头，下标和 SUFFIX_TYPE 一致
 };
 
 #endif // HTTPRESPONSE_H
\ No newline at end of file
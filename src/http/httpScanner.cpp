@@ -0,0 +1,212 @@
+#include "httpScanner.h"
+#include <string.h> // memchr
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HTTP_SCANNER_X86 1
+#endif
+
+// tchar = "!" / "#" / "$" / "%" / "&" / "'" / "*" / "+" / "-" / "." / "^" / "_" / "`" / "|" / "~" / DIGIT / ALPHA
+static constexpr bool tokenChar(unsigned char ch) {
+    return (ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z')
+        || ch == '!' || ch == '#' || ch == '$' || ch == '%' || ch == '&' || ch == '\''
+        || ch == '*' || ch == '+' || ch == '-' || ch == '.' || ch == '^' || ch == '_'
+        || ch == '`' || ch == '|' || ch == '~';
+}
+
+bool HttpScanner::isTokenChar(unsigned char ch) {
+    return tokenChar(ch);
+}
+
+const char* HttpScanner::findCRLFScalar(const char* begin, const char* end) {
+    const char* p = begin;
+    while (p + 1 < end) {
+        p = static_cast<const char*>(memchr(p, '\r', end - p - 1));
+        if (!p) {
+            return end;
+        }
+        if (p[1] == '\n') {
+            return p;
+        }
+        p++;
+    }
+    return end;
+}
+
+const char* HttpScanner::findCharScalar(const char* begin, const char* end, char ch) {
+    const char* p = static_cast<const char*>(memchr(begin, ch, end - begin));
+    return p ? p : end;
+}
+
+const char* HttpScanner::findNonTokenScalar(const char* begin, const char* end) {
+    for (const char* p = begin; p < end; p++) {
+        if (!tokenChar(static_cast<unsigned char>(*p))) {
+            return p;
+        }
+    }
+    return end;
+}
+
+#ifdef HTTP_SCANNER_X86
+
+// token 字符的位图：按低 4 位查一行，行里第 i 位表示高 4 位为 i 的字符是不是 token。
+// 只有 0x00-0x7f 会命中，高 4 位 >= 8 的字节（非 ASCII）查到的位选择为 0，自然判为非法。
+struct TokenLut {
+    unsigned char rows[16];
+    constexpr TokenLut() : rows() {
+        for (int lo = 0; lo < 16; lo++) {
+            unsigned char row = 0;
+            for (int hi = 0; hi < 8; hi++) {
+                if (tokenChar(static_cast<unsigned char>(hi << 4 | lo))) {
+                    row |= static_cast<unsigned char>(1 << hi);
+                }
+            }
+            rows[lo] = row;
+        }
+    }
+};
+static constexpr TokenLut TOKEN_LUT;
+alignas(32) static const unsigned char TOKEN_ROWS[32] = {
+    TOKEN_LUT.rows[0], TOKEN_LUT.rows[1], TOKEN_LUT.rows[2], TOKEN_LUT.rows[3],
+    TOKEN_LUT.rows[4], TOKEN_LUT.rows[5], TOKEN_LUT.rows[6], TOKEN_LUT.rows[7],
+    TOKEN_LUT.rows[8], TOKEN_LUT.rows[9], TOKEN_LUT.rows[10], TOKEN_LUT.rows[11],
+    TOKEN_LUT.rows[12], TOKEN_LUT.rows[13], TOKEN_LUT.rows[14], TOKEN_LUT.rows[15],
+    TOKEN_LUT.rows[0], TOKEN_LUT.rows[1], TOKEN_LUT.rows[2], TOKEN_LUT.rows[3],
+    TOKEN_LUT.rows[4], TOKEN_LUT.rows[5], TOKEN_LUT.rows[6], TOKEN_LUT.rows[7],
+    TOKEN_LUT.rows[8], TOKEN_LUT.rows[9], TOKEN_LUT.rows[10], TOKEN_LUT.rows[11],
+    TOKEN_LUT.rows[12], TOKEN_LUT.rows[13], TOKEN_LUT.rows[14], TOKEN_LUT.rows[15],
+};
+// 高 4 位 -> 行内的位，>= 8 的为 0
+alignas(32) static const unsigned char TOKEN_BITS[32] = {
+    1, 2, 4, 8, 16, 32, 64, 128, 0, 0, 0, 0, 0, 0, 0, 0,
+    1, 2, 4, 8, 16, 32, 64, 128, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+__attribute__((target("sse4.2")))
+static const char* findCRLFSse(const char* begin, const char* end) {
+    const __m128i cr = _mm_set1_epi8('\r');
+    const char* p = begin;
+    // 最后一个字节后面还要看 '\n'，所以块尾要留一个字节
+    while (p + 17 <= end) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, cr));
+        while (mask) {
+            int i = __builtin_ctz(mask);
+            if (p[i + 1] == '\n') {
+                return p + i;
+            }
+            mask &= mask - 1;
+        }
+        p += 16;
+    }
+    return HttpScanner::findCRLFScalar(p, end);
+}
+
+__attribute__((target("sse4.2")))
+static const char* findCharSse(const char* begin, const char* end, char ch) {
+    const __m128i c = _mm_set1_epi8(ch);
+    const char* p = begin;
+    while (p + 16 <= end) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, c));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+    return HttpScanner::findCharScalar(p, end, ch);
+}
+
+__attribute__((target("sse4.2")))
+static const char* findNonTokenSse(const char* begin, const char* end) {
+    const __m128i rows = _mm_load_si128(reinterpret_cast<const __m128i*>(TOKEN_ROWS));
+    const __m128i bits = _mm_load_si128(reinterpret_cast<const __m128i*>(TOKEN_BITS));
+    const __m128i low4 = _mm_set1_epi8(0x0f);
+    const char* p = begin;
+    while (p + 16 <= end) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i row = _mm_shuffle_epi8(rows, _mm_and_si128(v, low4));
+        __m128i bit = _mm_shuffle_epi8(bits, _mm_and_si128(_mm_srli_epi16(v, 4), low4));
+        __m128i bad = _mm_cmpeq_epi8(_mm_and_si128(row, bit), _mm_setzero_si128());
+        unsigned mask = _mm_movemask_epi8(bad);
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+    return HttpScanner::findNonTokenScalar(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char* findCRLFAvx2(const char* begin, const char* end) {
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const char* p = begin;
+    while (p + 33 <= end) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, cr));
+        while (mask) {
+            int i = __builtin_ctz(mask);
+            if (p[i + 1] == '\n') {
+                return p + i;
+            }
+            mask &= mask - 1;
+        }
+        p += 32;
+    }
+    return findCRLFSse(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char* findCharAvx2(const char* begin, const char* end, char ch) {
+    const __m256i c = _mm256_set1_epi8(ch);
+    const char* p = begin;
+    while (p + 32 <= end) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, c));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return findCharSse(p, end, ch);
+}
+
+__attribute__((target("avx2")))
+static const char* findNonTokenAvx2(const char* begin, const char* end) {
+    const __m256i rows = _mm256_load_si256(reinterpret_cast<const __m256i*>(TOKEN_ROWS));
+    const __m256i bits = _mm256_load_si256(reinterpret_cast<const __m256i*>(TOKEN_BITS));
+    const __m256i low4 = _mm256_set1_epi8(0x0f);
+    const char* p = begin;
+    while (p + 32 <= end) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i row = _mm256_shuffle_epi8(rows, _mm256_and_si256(v, low4));
+        __m256i bit = _mm256_shuffle_epi8(bits, _mm256_and_si256(_mm256_srli_epi16(v, 4), low4));
+        __m256i bad = _mm256_cmpeq_epi8(_mm256_and_si256(row, bit), _mm256_setzero_si256());
+        unsigned mask = _mm256_movemask_epi8(bad);
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return findNonTokenSse(p, end);
+}
+
+#endif // HTTP_SCANNER_X86
+
+HttpScanner::Impl HttpScanner::select_() {
+#ifdef HTTP_SCANNER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {"avx2", findCRLFAvx2, findCharAvx2, findNonTokenAvx2};
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        return {"sse4.2", findCRLFSse, findCharSse, findNonTokenSse};
+    }
+#endif
+    return {"scalar", findCRLFScalar, findCharScalar, findNonTokenScalar};
+}
+
+const HttpScanner::Impl& HttpScanner::impl() {
+    static const Impl instance = select_();  // 第一次用的时候检测一次 CPU
+    return instance;
+}
@@ -0,0 +1,42 @@
+#ifndef HTTPSCANNER_H
+#define HTTPSCANNER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 请求解析用的分隔符扫描：CRLF、冒号、空格，以及 token 字符校验
+// x86 上一次比较 16/32 字节（SSE4.2 / AVX2），启动时按 CPU 支持的指令集选实现，
+// 其他平台或者老 CPU 用逐字节的标量实现。所有函数都在 [begin, end) 上查找，找不到返回 end。
+class HttpScanner {
+public:
+    // 第一个 "\r\n" 的位置（指向 '\r'）
+    static const char* findCRLF(const char* begin, const char* end) { return impl().findCRLF(begin, end); }
+    // 第一个等于 ch 的字符
+    static const char* findChar(const char* begin, const char* end, char ch) { return impl().findChar(begin, end, ch); }
+    // 第一个不是 token 字符（RFC 7230 tchar）的位置，方法名、请求头名都必须是 token
+    static const char* findNonToken(const char* begin, const char* end) { return impl().findNonToken(begin, end); }
+    static bool isToken(const char* begin, const char* end) {
+        return begin < end && findNonToken(begin, end) == end;
+    }
+
+    // 当前使用的实现："avx2" / "sse4.2" / "scalar"
+    static const char* isaName() { return impl().name; }
+
+    // 标量实现，也是微基准的对照组
+    static const char* findCRLFScalar(const char* begin, const char* end);
+    static const char* findCharScalar(const char* begin, const char* end, char ch);
+    static const char* findNonTokenScalar(const char* begin, const char* end);
+    static bool isTokenChar(unsigned char ch);
+
+private:
+    struct Impl {
+        const char* name;
+        const char* (*findCRLF)(const char*, const char*);
+        const char* (*findChar)(const char*, const char*, char);
+        const char* (*findNonToken)(const char*, const char*);
+    };
+    static const Impl& impl();
+    static Impl select_();
+};
+
+#endif // HTTPSCANNER_H
@@ -0,0 +1,176 @@
+#ifndef HTTPTABLES_H
+#define HTTPTABLES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string_view>
+
+// 编译期生成的完美哈希表，给请求头名、路由、文件后缀这些固定的小集合用。
+// 构造时在编译期搜索一个种子，使所有 key 落在不同的槽里，查找只需要一次哈希、一次比较，
+// 没有链表、没有内存分配。找不到种子时编译报错（failNoPerfectHash 不是 constexpr）。
+template <typename V>
+struct StaticEntry {
+    std::string_view key;
+    V value;
+};
+
+void failNoPerfectHash();
+
+template <typename V, size_t N, bool ICase>
+class StaticMap {
+public:
+    // 槽数取不小于 2N 的 2 的幂，槽里存 entry 下标 + 1，0 表示空
+    static constexpr size_t SLOTS = [] {
+        size_t n = 1;
+        while (n < 2 * N) {
+            n <<= 1;
+        }
+        return n;
+    }();
+
+    constexpr StaticMap(const StaticEntry<V> (&entries)[N]) {
+        for (size_t i = 0; i < N; i++) {
+            m_entries[i] = entries[i];
+        }
+        for (m_seed = 0; m_seed < MAX_SEED; m_seed++) {
+            if (tryBuild_()) {
+                return;
+            }
+        }
+        failNoPerfectHash();
+    }
+
+    // 没有返回 nullptr
+    constexpr const V* find(std::string_view key) const {
+        int i = indexOf(key);
+        return i < 0 ? nullptr : &m_entries[i].value;
+    }
+    // key 在初始化列表里的下标，可以用来给每个 key 挂额外的数据；没有返回 -1
+    constexpr int indexOf(std::string_view key) const {
+        uint8_t i = m_slots[hash(key, m_seed) & (SLOTS - 1)];
+        if (i == 0 || !equal(m_entries[i - 1].key, key)) {
+            return -1;
+        }
+        return i - 1;
+    }
+
+    constexpr size_t size() const { return N; }
+    constexpr const StaticEntry<V>& operator[](size_t i) const { return m_entries[i]; }
+
+    static constexpr char lower(char ch) {
+        return (ICase && ch >= 'A' && ch <= 'Z') ? static_cast<char>(ch + ('a' - 'A')) : ch;
+    }
+    // FNV-1a，最后再混一下，让低位也依赖所有字符
+    static constexpr uint32_t hash(std::string_view s, uint32_t seed) {
+        uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+        for (char ch : s) {
+            h ^= static_cast<unsigned char>(lower(ch));
+            h *= 16777619u;
+        }
+        return h ^ (h >> 16);
+    }
+    static constexpr bool equal(std::string_view a, std::string_view b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); i++) {
+            if (lower(a[i]) != lower(b[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    static_assert(N < 255, "StaticMap is for small tables");
+    static constexpr uint32_t MAX_SEED = 100000;
+
+    constexpr bool tryBuild_() {
+        for (size_t s = 0; s < SLOTS; s++) {
+            m_slots[s] = 0;
+        }
+        for (size_t i = 0; i < N; i++) {
+            uint8_t& slot = m_slots[hash(m_entries[i].key, m_seed) & (SLOTS - 1)];
+            if (slot != 0) {
+                return false;
+            }
+            slot = static_cast<uint8_t>(i + 1);
+        }
+        return true;
+    }
+
+    StaticEntry<V> m_entries[N] = {};
+    uint8_t m_slots[SLOTS] = {};
+    uint32_t m_seed = 0;
+};
+
+// N 由初始化列表的长度推导： makeStaticMap<V, 大小写不敏感>({{key, value}, ...})
+template <typename V, bool ICase = false, size_t N>
+constexpr StaticMap<V, N, ICase> makeStaticMap(const StaticEntry<V> (&entries)[N]) {
+    return StaticMap<V, N, ICase>(entries);
+}
+
+// 常用请求头，HttpRequest 里按下标存在定长数组中，其他请求头才走线性表
+enum HTTP_HEADER {
+    HDR_ACCEPT,
+    HDR_ACCEPT_ENCODING,
+    HDR_CONNECTION,
+    HDR_CONTENT_LENGTH,
+    HDR_CONTENT_TYPE,
+    HDR_EXPECT,
+    HDR_HOST,
+    HDR_IF_MODIFIED_SINCE,
+    HDR_IF_NONE_MATCH,
+    HDR_IF_RANGE,
+    HDR_RANGE,
+    HDR_TRANSFER_ENCODING,
+    HDR_USER_AGENT,
+    HDR_COUNT,
+};
+
+inline constexpr auto KNOWN_HEADERS = makeStaticMap<HTTP_HEADER, true>({
+    {"Accept", HDR_ACCEPT},
+    {"Accept-Encoding", HDR_ACCEPT_ENCODING},
+    {"Connection", HDR_CONNECTION},
+    {"Content-Length", HDR_CONTENT_LENGTH},
+    {"Content-Type", HDR_CONTENT_TYPE},
+    {"Expect", HDR_EXPECT},
+    {"Host", HDR_HOST},
+    {"If-Modified-Since", HDR_IF_MODIFIED_SINCE},
+    {"If-None-Match", HDR_IF_NONE_MATCH},
+    {"If-Range", HDR_IF_RANGE},
+    {"Range", HDR_RANGE},
+    {"Transfer-Encoding", HDR_TRANSFER_ENCODING},
+    {"User-Agent", HDR_USER_AGENT},
+});
+static_assert(KNOWN_HEADERS.size() == HDR_COUNT, "KNOWN_HEADERS must list every HTTP_HEADER");
+
+// 状态码表：状态码本身就是下标，天然的完美哈希
+class StatusTable {
+public:
+    struct Status {
+        int code;
+        std::string_view text;  // 状态信息
+        std::string_view page;  // 对应的错误页面，没有为空
+    };
+    template <size_t N>
+    constexpr StatusTable(const Status (&list)[N]) {
+        for (size_t i = 0; i < N; i++) {
+            m_table[list[i].code - MIN_CODE] = list[i];
+        }
+    }
+    // 不认识的状态码返回 nullptr
+    constexpr const Status* find(int code) const {
+        if (code < MIN_CODE || code > MAX_CODE || m_table[code - MIN_CODE].code == 0) {
+            return nullptr;
+        }
+        return &m_table[code - MIN_CODE];
+    }
+
+private:
+    static constexpr int MIN_CODE = 100;
+    static constexpr int MAX_CODE = 599;
+    Status m_table[MAX_CODE - MIN_CODE + 1] = {};
+};
+
+#endif // HTTPTABLES_H
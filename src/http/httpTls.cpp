@@ -0,0 +1,96 @@
+#include "httpTls.h"
+#include "../log/log.h"
+#include <signal.h>
+
+HttpTls* HttpTls::instance() {
+    static HttpTls tls;
+    return &tls;
+}
+
+HttpTls::HttpTls() : m_ctx(nullptr), m_handshakes(0), m_failures(0), m_ktlsTx(0), m_ktlsRx(0),
+    m_kernelBytes(0), m_userBytes(0) {}
+
+HttpTls::~HttpTls() {
+    if (m_ctx) {
+        SSL_CTX_free(m_ctx);
+    }
+}
+
+static void logSslError(const char* what) {
+    char buf[256];
+    unsigned long err = ERR_get_error();
+    ERR_error_string_n(err, buf, sizeof(buf));
+    fprintf(stderr, "%s: %s\n", what, buf);  // 在日志初始化之前调用
+}
+
+bool HttpTls::init(const std::string& certFile, const std::string& keyFile) {
+    // OpenSSL 用 write() 写 socket，不带 MSG_NOSIGNAL，对方断开后再写（包括 SSL_shutdown）会收到 SIGPIPE 把进程杀掉；
+    // 忽略之后 write 返回 EPIPE，按写失败关连接
+    signal(SIGPIPE, SIG_IGN);
+    m_ctx = SSL_CTX_new(TLS_server_method());
+    if (!m_ctx) {
+        logSslError("SSL_CTX_new");
+        return false;
+    }
+    SSL_CTX_set_min_proto_version(m_ctx, TLS1_2_VERSION);
+    // 重协商会换密钥，内核里的 kTLS 状态处理不了
+    SSL_CTX_set_options(m_ctx, SSL_OP_ENABLE_KTLS | SSL_OP_NO_RENEGOTIATION);
+    // 退回 SSL_write 时：允许部分写入；重试时文件段是重新 pread 到栈上的，地址会变
+    SSL_CTX_set_mode(m_ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    // 只用内核 kTLS 支持的 AEAD 算法
+    SSL_CTX_set_cipher_list(m_ctx, "ECDHE+AESGCM:ECDHE+CHACHA20");
+    SSL_CTX_set_ciphersuites(m_ctx, "TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384:TLS_CHACHA20_POLY1305_SHA256");
+    if (SSL_CTX_use_certificate_chain_file(m_ctx, certFile.c_str()) != 1) {
+        logSslError(certFile.c_str());
+    } else if (SSL_CTX_use_PrivateKey_file(m_ctx, keyFile.c_str(), SSL_FILETYPE_PEM) != 1) {
+        logSslError(keyFile.c_str());
+    } else if (SSL_CTX_check_private_key(m_ctx) != 1) {
+        logSslError("check private key");
+    } else {
+        return true;
+    }
+    SSL_CTX_free(m_ctx);
+    m_ctx = nullptr;
+    return false;
+}
+
+SSL* HttpTls::newSession(int fd) {
+    SSL* ssl = SSL_new(m_ctx);
+    if (ssl) {
+        SSL_set_fd(ssl, fd);
+        SSL_set_accept_state(ssl);
+    }
+    return ssl;
+}
+
+int HttpTls::handshake(SSL* ssl) {
+    ERR_clear_error();
+    int ret = SSL_do_handshake(ssl);
+    if (ret == 1) {
+        m_handshakes++;
+#ifndef OPENSSL_NO_KTLS
+        if (BIO_get_ktls_send(SSL_get_wbio(ssl))) {
+            m_ktlsTx++;
+        }
+        if (BIO_get_ktls_recv(SSL_get_rbio(ssl))) {
+            m_ktlsRx++;
+        }
+#endif
+        return 1;
+    }
+    int err = SSL_get_error(ssl, ret);
+    if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
+        return 0;
+    }
+    m_failures++;
+    LOG_DEBUG("TLS handshake failed: %s", ERR_reason_error_string(ERR_peek_error()));
+    return -1;
+}
+
+bool HttpTls::ktlsSend(SSL* ssl) {
+#ifndef OPENSSL_NO_KTLS
+    return BIO_get_ktls_send(SSL_get_wbio(ssl));
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,53 @@
+#ifndef HTTPTLS_H
+#define HTTPTLS_H
+
+#include <string>
+#include <atomic>
+#include <stdint.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+// HTTPS：握手由 OpenSSL 在用户态做，握手完成后对称加密交给内核（kTLS，SSL_OP_ENABLE_KTLS）。
+// 发送方向进了内核之后，socket 上的 sendmsg/sendfile 由内核加密，HttpConn 原来的零拷贝发送路径不用改；
+// 内核不支持 kTLS（没有 tls 模块、算法不支持）时退回 SSL_write，文件段先 pread 出来再加密。
+// 接收一律走 SSL_read，内核接管了接收方向时 OpenSSL 内部直接读明文。
+class HttpTls {
+public:
+    static HttpTls* instance();
+
+    // 证书链和私钥都是 PEM 文件，可以是同一个；服务器启动前调用
+    bool init(const std::string& certFile, const std::string& keyFile);
+    bool enabled() const { return m_ctx != nullptr; }
+
+    // 给新连接创建会话，服务端模式
+    SSL* newSession(int fd);
+    // 非阻塞握手：1 完成，0 还要等数据，-1 失败
+    int handshake(SSL* ssl);
+    // 发送方向是否已经交给内核
+    static bool ktlsSend(SSL* ssl);
+
+    void addKernelBytes(uint64_t n) { m_kernelBytes.fetch_add(n, std::memory_order_relaxed); }
+    void addUserBytes(uint64_t n) { m_userBytes.fetch_add(n, std::memory_order_relaxed); }
+
+    // 统计
+    uint64_t handshakes() const { return m_handshakes; }
+    uint64_t failures() const { return m_failures; }
+    uint64_t ktlsTx() const { return m_ktlsTx; }  // 发送方向用上 kTLS 的连接数
+    uint64_t ktlsRx() const { return m_ktlsRx; }
+    uint64_t kernelBytes() const { return m_kernelBytes; }  // 内核加密发出的明文字节数
+    uint64_t userBytes() const { return m_userBytes; }  // SSL_write 加密发出的明文字节数
+
+private:
+    HttpTls();
+    ~HttpTls();
+
+    SSL_CTX* m_ctx;
+    std::atomic<uint64_t> m_handshakes;
+    std::atomic<uint64_t> m_failures;
+    std::atomic<uint64_t> m_ktlsTx;
+    std::atomic<uint64_t> m_ktlsRx;
+    std::atomic<uint64_t> m_kernelBytes;
+    std::atomic<uint64_t> m_userBytes;
+};
+
+#endif // HTTPTLS_H
@@ -124,6 +124,7 @@ void Log::init(int level, const char* path, const char* suffix, bool isPrintCons
     {
         std::unique_lock<std::mutex> locker(m_mutex);
         m_buffer.retrieveAll();  // 清空 buffer，取出所有数据
+        m_buffer.handoff();
         m_count = 0;
         // 如果已经打开了文件，先关闭文件
         if(m_fp) {
@@ -198,6 +199,7 @@ void Log::write(int level,const char* format, ...) {
         //                 t.tm_min, t.tm_sec, now.tv_usec,file,line,thread_id_str.c_str());
         // [%s:%d] [Tid: %s]
         // ,file,line,thread_id_str.c_str()
+        m_buffer.ensureWriteableBytes(4096);  // 一行放在一个段里，peek() 不用合并
         int n = snprintf(m_buffer.beginWrite(), 128, 
                 "%04d-%02d-%02d %02d:%02d:%02d.%06ld ", 
                 t.tm_year + 1900, t.tm_mon + 1, 
@@ -207,9 +209,12 @@ void Log::write(int level,const char* format, ...) {
         appendLogLevelTitle(level);
 
         va_start(vaList, format);  // 初始化vaList,准备读取可变参数，format为定位符
+        m_buffer.ensureWriteableBytes(1024);
         int m = vsnprintf(m_buffer.beginWrite(), m_buffer.writeableBytes(), format, vaList);
         va_end(vaList);  // 清空vaList，完成可变参数的读取
-        m_buffer.hasWritten(m);
+        if(m > 0) {
+            m_buffer.hasWritten(std::min<size_t>(m, m_buffer.writeableBytes() - 1));  // 超过一个段的部分被截断
+        }
         m_buffer.append("\n\0", 2);
         
         
@@ -229,6 +234,7 @@ void Log::write(int level,const char* format, ...) {
             }
         }
         m_buffer.retrieveAll();  // 清空 buffer
+        m_buffer.handoff();  // 各个线程轮流用，由 m_mutex 保证同一时刻只有一个
     }
     // std::cout<< "可读:"<<m_buffer.readableBytes()<<std::endl;
     // std::cout<< "可写:"<<m_buffer.writeableBytes()<<std::endl;
@@ -5,6 +5,7 @@
 #include "../buffer/buffer.h"
 #include <thread>
 #include <mutex>
+#include <atomic>
 #include <assert.h>
 #include <sys/time.h>
 #include <stdarg.h>
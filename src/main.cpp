@@ -1,11 +1,66 @@
 #include <unistd.h>
+#include <stdlib.h>
 #include "server/webserver.h"
 
-int main() {
+int main(int argc, char* argv[]) {
+    int threadNum = 6;   // 线程池数量, -t 指定
+    int reactorNum = 1;  // reactor数量, -r 指定, 0 表示按 CPU 核数
+    int dispatchMode = webServer::REUSEPORT;  // 新连接分配方式, -d 指定: 0 SO_REUSEPORT 1 轮询 2 最少连接
+    int pollerType = Poller::EPOLL;  // IO 多路复用后端, -p 指定: 0 epoll 1 io_uring
+    size_t cacheMB = 64;  // 静态响应缓存容量（MB）, -c 指定, 0 表示关闭
+    size_t cacheObjKB = 1024;  // 单个响应的缓存上限（KB）, -o 指定
+    size_t openFiles = 1024;  // 打开文件缓存的条目数, -f 指定, 0 表示关闭
+    int openFileValid = 60;  // 打开文件缓存的有效期（秒）, -v 指定
+    const char* archive = nullptr;  // 资源包（packassets 生成）, -a 指定, 指定后静态文件都从包里发
+    bool hugepages = false;  // 资源包放进透明大页, -g 开启
+    int idleSec = 15;  // 保持的连接空闲多少秒关掉, -i 指定, 0 表示和处理请求的超时一样
+    const char* certFile = nullptr;  // HTTPS 证书链（PEM）, -s 指定, 指定后监听端口只接受 TLS
+    const char* keyFile = nullptr;  // 私钥（PEM）, -k 指定, 不指定就和证书在同一个文件里
+    int opt;
+    while((opt = getopt(argc, argv, "t:r:d:p:H:B:c:o:C:f:v:a:gq:s:k:m:i:")) != -1) {
+        switch(opt) {
+            case 't': threadNum = atoi(optarg); break;
+            case 'r': reactorNum = atoi(optarg); break;
+            case 'd': dispatchMode = atoi(optarg); break;
+            case 'p': pollerType = atoi(optarg); break;
+            case 'H': HttpRequest::maxHeaderSize = strtoul(optarg, nullptr, 10); break;  // 请求头上限（字节）
+            case 'B': HttpRequest::maxBodySize = strtoul(optarg, nullptr, 10); break;  // 请求体上限（字节）
+            case 'c': cacheMB = strtoul(optarg, nullptr, 10); break;
+            case 'o': cacheObjKB = strtoul(optarg, nullptr, 10); break;
+            case 'C':  // 缓存策略，覆盖默认值，如 ".css:3600,.html:-1"
+                if(!HttpResponse::setCachePolicy(optarg)) {
+                    fprintf(stderr, "bad cache policy: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'f': openFiles = strtoul(optarg, nullptr, 10); break;
+            case 'v': openFileValid = atoi(optarg); break;
+            case 'a': archive = optarg; break;
+            case 'g': hugepages = true; break;
+            case 'q': HttpConn::writeQuantum = strtoul(optarg, nullptr, 10) << 10; break;  // 每次可写事件最多发多少 KB，0 不限
+            case 's': certFile = optarg; break;
+            case 'k': keyFile = optarg; break;
+            case 'm': HttpConn::keepAliveRequests = atoi(optarg); break;  // 每个连接最多处理多少个请求，0 不保持连接
+            case 'i': idleSec = atoi(optarg); break;
+            default: break;
+        }
+    }
+    HttpConn::keepAliveTimeout = idleSec * 1000;
+    HttpCache::instance()->init(cacheMB << 20, cacheObjKB << 10);
+    HttpFileCache::instance()->init(openFiles, openFileValid);
+    if(archive && !HttpArchive::instance()->load(archive, hugepages)) {
+        fprintf(stderr, "load archive %s failed\n", archive);
+        return 1;
+    }
+    if(certFile && !HttpTls::instance()->init(certFile, keyFile ? keyFile : certFile)) {
+        fprintf(stderr, "load certificate %s failed\n", certFile);
+        return 1;
+    }
     // 守护进程 后台运行 
     webServer server(
         1316, 3, 60000, false,             /* 端口 ET模式 timeoutMs 优雅退出  */
         3306, "root", "123456789", "yourdb", /* Mysql配置 连接池的配置,和database的名字 */
-        12, 6, true, 1, 1024);             /* 连接池数量 线程池数量 日志开关 日志等级 日志异步队列容量 */
+        12, threadNum, reactorNum, dispatchMode, /* 连接池数量 线程池数量 reactor数量 分配方式 */
+        pollerType, true, 1, 1024);        /* IO后端 日志开关 日志等级 日志异步队列容量 */
     server.start();
-} 
\ No newline at end of file
+}
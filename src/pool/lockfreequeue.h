@@ -0,0 +1,72 @@
+#ifndef LOCKFREEQUEUE_H
+#define LOCKFREEQUEUE_H
+
+#include <vector>
+#include <atomic>
+#include <assert.h>
+
+// 有界无锁环形队列，只允许一个生产者线程和一个消费者线程（SPSC）
+// 用于 acceptor 线程把新连接交给 sub-reactor，push/pop 都不加锁
+template<typename T>
+class LockFreeQueue {
+public:
+    explicit LockFreeQueue(size_t capacity = 1024);
+    ~LockFreeQueue() = default;
+
+    bool push(const T& value);  // 生产者调用，队列满了返回false
+    bool pop(T& value);  // 消费者调用，队列空了返回false
+
+    bool empty() const;
+    size_t size() const;
+
+private:
+    std::vector<T> m_buffer;  // 环形数组，容量为2的幂
+    size_t m_mask;  // 容量-1，用来取模
+    alignas(64) std::atomic<size_t> m_head;  // 消费位置，只有消费者写
+    alignas(64) std::atomic<size_t> m_tail;  // 生产位置，只有生产者写
+};
+
+template<typename T>
+LockFreeQueue<T>::LockFreeQueue(size_t capacity) : m_head(0), m_tail(0) {
+    assert(capacity > 0);
+    size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;  // 向上取2的幂
+    }
+    m_buffer.resize(size);
+    m_mask = size - 1;
+}
+
+template<typename T>
+bool LockFreeQueue<T>::push(const T& value) {
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) > m_mask) {
+        return false;  // 满了
+    }
+    m_buffer[tail & m_mask] = value;
+    m_tail.store(tail + 1, std::memory_order_release);  // 发布元素
+    return true;
+}
+
+template<typename T>
+bool LockFreeQueue<T>::pop(T& value) {
+    size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire)) {
+        return false;  // 空了
+    }
+    value = m_buffer[head & m_mask];
+    m_head.store(head + 1, std::memory_order_release);  // 归还槽位
+    return true;
+}
+
+template<typename T>
+bool LockFreeQueue<T>::empty() const {
+    return size() == 0;
+}
+
+template<typename T>
+size_t LockFreeQueue<T>::size() const {
+    return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+}
+
+#endif // LOCKFREEQUEUE_H
@@ -0,0 +1,80 @@
+#include "connslab.h"
+
+ConnSlab::ConnSlab(int maxFd) : m_maxFd(maxFd), m_chunks((maxFd + CHUNK_SIZE - 1) >> CHUNK_SHIFT) {
+    assert(maxFd > 0);
+    for (auto& chunk : m_chunks) {
+        chunk.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+ConnSlab::~ConnSlab() {
+    for (auto& chunk : m_chunks) {
+        delete[] chunk.load();
+    }
+}
+
+ConnSlab::Slot* ConnSlab::slot_(int fd) const {
+    if (fd < 0 || fd >= m_maxFd) {
+        return nullptr;
+    }
+    Slot* chunk = m_chunks[fd >> CHUNK_SHIFT].load(std::memory_order_acquire);
+    if (!chunk) {
+        return nullptr;
+    }
+    return &chunk[fd & (CHUNK_SIZE - 1)];
+}
+
+HttpConn* ConnSlab::acquire(int fd, int owner, uint32_t* gen) {
+    assert(fd >= 0 && fd < m_maxFd && gen);
+    std::atomic<Slot*>& chunkPtr = m_chunks[fd >> CHUNK_SHIFT];
+    if (!chunkPtr.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> locker(m_mtx);
+        if (!chunkPtr.load(std::memory_order_relaxed)) {
+            chunkPtr.store(new Slot[CHUNK_SIZE], std::memory_order_release);  // 整块预分配
+        }
+    }
+    Slot* slot = slot_(fd);
+    slot->owner = owner;
+    uint32_t g = slot->gen.load(std::memory_order_relaxed);
+    if (g % 2 == 0) {
+        g++;  // 空闲 -> 使用中
+    } else {
+        g += 2;  // 上一个连接没走 release（不应该发生），跳过它的 generation
+    }
+    slot->gen.store(g, std::memory_order_release);
+    *gen = g;
+    return &slot->conn;
+}
+
+void ConnSlab::release(int fd) {
+    Slot* slot = slot_(fd);
+    assert(slot);
+    uint32_t g = slot->gen.load(std::memory_order_relaxed);
+    if (g % 2 == 1) {
+        slot->gen.store(g + 1, std::memory_order_release);  // 使用中 -> 空闲
+    }
+    slot->owner = -1;
+}
+
+HttpConn* ConnSlab::get(int fd) const {
+    Slot* slot = slot_(fd);
+    return slot ? &slot->conn : nullptr;
+}
+
+HttpConn* ConnSlab::get(int fd, uint32_t gen) const {
+    Slot* slot = slot_(fd);
+    if (!slot || slot->gen.load(std::memory_order_acquire) != gen) {
+        return nullptr;
+    }
+    return &slot->conn;
+}
+
+uint32_t ConnSlab::gen(int fd) const {
+    Slot* slot = slot_(fd);
+    return slot ? slot->gen.load(std::memory_order_acquire) : 0;
+}
+
+int ConnSlab::owner(int fd) const {
+    Slot* slot = slot_(fd);
+    return slot ? slot->owner : -1;
+}
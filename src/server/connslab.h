@@ -0,0 +1,51 @@
+#ifndef CONNSLAB_H
+#define CONNSLAB_H
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <assert.h>
+#include "../http/httpConn.h"
+
+// 按 fd 下标存放连接的 slab，所有 reactor 共用（fd 在进程内唯一）
+// 槽位按块（CHUNK_SIZE 个）预分配，查找就是两次数组下标，不用哈希。
+// 每个槽位有一个 generation，连接建立和关闭时都会加一，
+// 定时器、线程池的回调只保存 (fd, generation)，执行前用 get(fd, gen) 校验，
+// fd 被关闭或者复用给新连接之后，旧回调拿到的是 nullptr。
+class ConnSlab {
+public:
+    explicit ConnSlab(int maxFd);
+    ~ConnSlab();
+
+    // 新连接占用 fd 对应的槽位，返回连接并通过 gen 返回新的 generation
+    HttpConn* acquire(int fd, int owner, uint32_t* gen);
+    // 连接关闭后释放槽位，generation 加一让旧回调失效
+    void release(int fd);
+    // 事件循环里用：fd 一定是本 reactor 正在使用的连接
+    HttpConn* get(int fd) const;
+    // 回调里用：generation 对不上说明连接已经换人或关闭了
+    HttpConn* get(int fd, uint32_t gen) const;
+    // fd 当前的 generation
+    uint32_t gen(int fd) const;
+    // fd 所属的 reactor，没有被占用返回 -1
+    int owner(int fd) const;
+
+    int maxFd() const { return m_maxFd; }
+
+private:
+    struct Slot {
+        HttpConn conn;
+        std::atomic<uint32_t> gen{0};  // 偶数：空闲，奇数：使用中
+        int owner = -1;  // 所属 reactor
+    };
+    static const int CHUNK_SHIFT = 10;
+    static const int CHUNK_SIZE = 1 << CHUNK_SHIFT;  // 每块 1024 个槽位
+
+    Slot* slot_(int fd) const;
+
+    int m_maxFd;
+    std::vector<std::atomic<Slot*>> m_chunks;  // 块指针，第一次用到时分配
+    std::mutex m_mtx;  // 只在分配新块时用
+};
+
+#endif // CONNSLAB_H
@@ -15,6 +15,7 @@ bool Epoller::addFd(int fd, uint32_t events) {
     ev.data.fd = fd;
     ev.events = events;  // events是个位掩码，可以是EPOLLIN, EPOLLOUT等
     // 添加新的事件到epoll中，但是不会立即激活，就是没有操作事件数组
+    countSyscall_();
     return 0 == epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev);  
 }
 
@@ -23,16 +24,19 @@ bool Epoller::modFd(int fd, uint32_t events) {
     ev.data.fd = fd;
     ev.events = events;
     // 修改事件，如果fd不在epoll中，会返回错误
+    countSyscall_();
     return 0 == epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev);  // 修改事件
 }
 
 bool Epoller::delFd(int fd) {
     // 删除事件
+    countSyscall_();
     return 0 == epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, 0);  
 }
 
 int Epoller::wait(int timeoutMs) {
     // 等待事件
+    countSyscall_();
     return epoll_wait(epollFd_, &events_[0], static_cast<int>(events_.size()), timeoutMs);  
 }
 
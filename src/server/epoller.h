@@ -6,25 +6,26 @@
 #include <assert.h>
 #include <vector>
 #include <errno.h>
+#include "poller.h"
 
-class Epoller {
+class Epoller : public Poller {
 public:
     // maxEvent: epoll_wait()最多监听的事件数
     Epoller(int maxEvent = 1024);   
-    ~Epoller();
+    ~Epoller() override;
     // 添加事件
-    bool addFd(int fd, uint32_t events); 
+    bool addFd(int fd, uint32_t events) override; 
     // 修改事件
-    bool modFd(int fd, uint32_t events); 
+    bool modFd(int fd, uint32_t events) override; 
     // 删除事件
-    bool delFd(int fd);  
+    bool delFd(int fd) override;  
     // 等待事件
-    int wait(int timeoutMs = -1);  
+    int wait(int timeoutMs = -1) override;  
  
     // 获取第i个事件的fd
-    int getEventFd(size_t i) const;  
+    int getEventFd(size_t i) const override;  
     // 获取第i个事件的事件类型
-    uint32_t getEvents(size_t i) const; 
+    uint32_t getEvents(size_t i) const override; 
 
 private:
     // epoll句柄
@@ -0,0 +1,131 @@
+#include "filewatcher.h"
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include "../log/log.h"
+
+// 文件内容、权限变化，目录里有东西增删、改名
+static const uint32_t WATCH_MASK = IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE
+                                 | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+
+FileWatcher::FileWatcher() : m_fd(-1), m_events(0), m_invalidations(0), m_rescans(0) {}
+
+FileWatcher::~FileWatcher() {
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+}
+
+bool FileWatcher::init(const std::string& root, const Callback& cb) {
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0) {
+        LOG_ERROR("inotify_init1 error: %s", strerror(errno));
+        return false;
+    }
+    m_root = root;
+    while (!m_root.empty() && m_root.back() == '/') {
+        m_root.pop_back();
+    }
+    m_cb = cb;
+    watchTree_("", m_dirs);
+    if (m_dirs.empty()) {
+        close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    LOG_INFO("FileWatcher: watching %zu dirs under %s", m_dirs.size(), m_root.c_str());
+    return true;
+}
+
+// 目录里的子目录也逐个加监视，不跟符号链接，避免成环
+void FileWatcher::watchTree_(const std::string& dir, std::unordered_map<int, std::string>& dirs) {
+    std::string full = m_root + dir;
+    int wd = inotify_add_watch(m_fd, full.c_str(), WATCH_MASK);
+    if (wd < 0) {
+        LOG_WARN("inotify_add_watch %s error: %s", full.c_str(), strerror(errno));  // 一般是 max_user_watches 不够
+        return;
+    }
+    dirs[wd] = dir;
+    DIR* dp = opendir(full.c_str());
+    if (!dp) {
+        return;
+    }
+    while (struct dirent* ent = readdir(dp)) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) {
+            continue;
+        }
+        bool isDir = ent->d_type == DT_DIR;
+        if (ent->d_type == DT_UNKNOWN) {
+            struct stat st;
+            isDir = lstat((full + "/" + ent->d_name).c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+        }
+        if (isDir) {
+            watchTree_(dir + "/" + ent->d_name, dirs);
+        }
+    }
+    closedir(dp);
+}
+
+void FileWatcher::rescan_() {
+    std::unordered_map<int, std::string> dirs;
+    watchTree_("", dirs);  // 已经在监视的目录返回原来的 wd，改过名的路径在这里更新
+    for (auto& kv : m_dirs) {
+        if (!dirs.count(kv.first)) {
+            inotify_rm_watch(m_fd, kv.first);  // 移出了资源目录
+        }
+    }
+    m_dirs.swap(dirs);
+    m_rescans++;
+    LOG_INFO("FileWatcher: rescan, watching %zu dirs", m_dirs.size());
+    notify_("");
+}
+
+void FileWatcher::notify_(const std::string& path) {
+    m_invalidations++;
+    LOG_DEBUG("FileWatcher: %s changed", path.empty() ? "*" : path.c_str());
+    m_cb(path);
+    // 预压缩的 .br/.gz 是原文件的一个变体，它变了原文件的缓存也要失效
+    size_t n = path.size();
+    if (n > 3 && (path.compare(n - 3, 3, ".br") == 0 || path.compare(n - 3, 3, ".gz") == 0)) {
+        m_cb(path.substr(0, n - 3));
+    }
+}
+
+void FileWatcher::handle() {
+    alignas(struct inotify_event) char buf[4096];
+    bool rescan = false;
+    for (;;) {
+        ssize_t n = read(m_fd, buf, sizeof(buf));
+        if (n <= 0) {
+            break;  // EAGAIN，读完了
+        }
+        for (char* p = buf; p < buf + n; ) {
+            struct inotify_event* ev = reinterpret_cast<struct inotify_event*>(p);
+            p += sizeof(struct inotify_event) + ev->len;
+            m_events++;
+            if (ev->mask & IN_Q_OVERFLOW) {
+                rescan = true;  // 内核队列满了丢了事件，不知道哪些文件变了
+                continue;
+            }
+            if (ev->mask & IN_IGNORED) {
+                m_dirs.erase(ev->wd);  // 目录被删了，监视自动去掉
+                continue;
+            }
+            auto it = m_dirs.find(ev->wd);
+            if (it == m_dirs.end() || ev->len == 0) {
+                continue;
+            }
+            if (ev->mask & IN_ISDIR) {
+                rescan = true;  // 目录增删、改名：下面的文件都可能变了，重新建立监视
+                continue;
+            }
+            notify_(it->second + "/" + ev->name);
+        }
+    }
+    if (rescan) {
+        rescan_();
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef FILEWATCHER_H
+#define FILEWATCHER_H
+
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <stdint.h>
+
+// 用 inotify 递归监视资源目录，文件被修改、创建、删除、改名时通知上层让缓存失效。
+// fd() 加进某个 reactor 的 poller（水平触发），可读时在事件循环里调 handle()，不用单独的线程；
+// 有了它，缓存命中时不需要再 stat 检查文件有没有变。
+class FileWatcher {
+public:
+    // path 是相对资源目录、以 / 开头的路径，和请求路径一致；空字符串表示全部失效
+    typedef std::function<void(const std::string& path)> Callback;
+
+    FileWatcher();
+    ~FileWatcher();
+
+    bool init(const std::string& root, const Callback& cb);
+    int fd() const { return m_fd; }
+    // 读出所有就绪的事件并通知，不会阻塞
+    void handle();
+
+    // 统计
+    uint64_t events() const { return m_events; }
+    uint64_t invalidations() const { return m_invalidations; }
+    uint64_t rescans() const { return m_rescans; }
+    size_t watches() const { return m_dirs.size(); }
+
+private:
+    void rescan_();  // 重新遍历目录树，补上新目录的监视，去掉已经不在树里的
+    void watchTree_(const std::string& dir, std::unordered_map<int, std::string>& dirs);
+    void notify_(const std::string& path);
+
+    int m_fd;
+    std::string m_root;  // 不带结尾的 /
+    Callback m_cb;
+    std::unordered_map<int, std::string> m_dirs;  // wd -> 目录，相对 m_root，根目录为空
+    uint64_t m_events;
+    uint64_t m_invalidations;
+    uint64_t m_rescans;
+};
+
+#endif // FILEWATCHER_H
@@ -0,0 +1,16 @@
+#include "poller.h"
+#include "epoller.h"
+#include "uringpoller.h"
+#include "../log/log.h"
+
+Poller* Poller::create(int type, int maxEvent) {
+    if(type == IO_URING) {
+        UringPoller* poller = new UringPoller(maxEvent);
+        if(poller->isValid()) {
+            return poller;
+        }
+        delete poller;
+        LOG_WARN("io_uring unavailable, fall back to epoll");
+    }
+    return new Epoller(maxEvent);
+}
@@ -0,0 +1,45 @@
+#ifndef POLLER_H
+#define POLLER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <sys/epoll.h> // 事件掩码统一用 EPOLLIN/EPOLLOUT/EPOLLONESHOT 等
+
+// IO 多路复用的抽象接口，webServer 只依赖它
+// 事件语义与 epoll 一致：EPOLLONESHOT 的 fd 触发一次后要 modFd 重新注册
+class Poller {
+public:
+    enum PollerType {
+        EPOLL = 0,  // epoll_ctl/epoll_wait
+        IO_URING,   // io_uring 的 POLL_ADD，重新注册攒批到下一次 wait 一起提交
+    };
+
+    virtual ~Poller() = default;
+    // 添加事件
+    virtual bool addFd(int fd, uint32_t events) = 0;
+    // 修改事件
+    virtual bool modFd(int fd, uint32_t events) = 0;
+    // 删除事件
+    virtual bool delFd(int fd) = 0;
+    // 等待事件
+    virtual int wait(int timeoutMs = -1) = 0;
+
+    // 获取第i个事件的fd
+    virtual int getEventFd(size_t i) const = 0;
+    // 获取第i个事件的事件类型
+    virtual uint32_t getEvents(size_t i) const = 0;
+
+    // 累计的系统调用次数，用来比较不同后端；统计线程读，所以是原子变量
+    uint64_t syscalls() const { return syscalls_.load(std::memory_order_relaxed); }
+
+    // 按类型创建，io_uring 不可用时退回 epoll
+    static Poller* create(int type, int maxEvent = 1024);
+
+protected:
+    void countSyscall_() { syscalls_.fetch_add(1, std::memory_order_relaxed); }
+
+    std::atomic<uint64_t> syscalls_{0};
+};
+
+#endif // POLLER_H
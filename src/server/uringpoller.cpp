@@ -0,0 +1,251 @@
+#include "uringpoller.h"
+#include <string.h> // memset
+#include <time.h> // timespec
+#include <algorithm> // std::max
+
+static int io_uring_setup(unsigned entries, io_uring_params* p) {
+    return (int)syscall(SYS_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, void* arg, size_t argSize) {
+    return (int)syscall(SYS_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize);
+}
+
+UringPoller::UringPoller(int maxEvent) :
+    ringFd_(-1), features_(0), sqRing_(MAP_FAILED), sqRingSize_(0), sqes_((io_uring_sqe*)MAP_FAILED), sqesSize_(0),
+    sqEntries_(0), cqRing_(MAP_FAILED), cqRingSize_(0), events_(maxEvent), maxEvent_(maxEvent) {
+    assert(maxEvent > 0);
+    // SQ 要放得下一轮里所有的重新注册，CQ 默认是 SQ 的两倍
+    if(!setup_(4096)) {
+        release_();
+    }
+    events_.clear();
+}
+
+UringPoller::~UringPoller() {
+    release_();
+}
+
+void UringPoller::release_() {
+    if(sqes_ != MAP_FAILED) {
+        munmap(sqes_, sqesSize_);
+        sqes_ = (io_uring_sqe*)MAP_FAILED;
+    }
+    if(cqRing_ != MAP_FAILED && cqRing_ != sqRing_) {
+        munmap(cqRing_, cqRingSize_);
+    }
+    cqRing_ = MAP_FAILED;
+    if(sqRing_ != MAP_FAILED) {
+        munmap(sqRing_, sqRingSize_);
+        sqRing_ = MAP_FAILED;
+    }
+    if(ringFd_ >= 0) {
+        close(ringFd_);
+        ringFd_ = -1;
+    }
+}
+
+bool UringPoller::setup_(unsigned entries) {
+    io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    ringFd_ = io_uring_setup(entries, &p);
+    if(ringFd_ < 0) {
+        return false;
+    }
+    features_ = p.features;
+    // wait() 的超时依赖 EXT_ARG（5.11+），没有就不用 io_uring
+    if(!(features_ & IORING_FEAT_EXT_ARG)) {
+        return false;
+    }
+    sqRingSize_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqRingSize_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    if(features_ & IORING_FEAT_SINGLE_MMAP) {
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    }
+    sqRing_ = mmap(0, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    if(sqRing_ == MAP_FAILED) {
+        return false;
+    }
+    if(features_ & IORING_FEAT_SINGLE_MMAP) {
+        cqRing_ = sqRing_;
+    } else {
+        cqRing_ = mmap(0, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+        if(cqRing_ == MAP_FAILED) {
+            return false;
+        }
+    }
+    sqesSize_ = p.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = (io_uring_sqe*)mmap(0, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+    if(sqes_ == MAP_FAILED) {
+        return false;
+    }
+    char* sq = (char*)sqRing_;
+    sqHead_ = (unsigned*)(sq + p.sq_off.head);
+    sqTail_ = (unsigned*)(sq + p.sq_off.tail);
+    sqMask_ = (unsigned*)(sq + p.sq_off.ring_mask);
+    sqArray_ = (unsigned*)(sq + p.sq_off.array);
+    sqEntries_ = p.sq_entries;
+    char* cq = (char*)cqRing_;
+    cqHead_ = (unsigned*)(cq + p.cq_off.head);
+    cqTail_ = (unsigned*)(cq + p.cq_off.tail);
+    cqMask_ = (unsigned*)(cq + p.cq_off.ring_mask);
+    cqes_ = (io_uring_cqe*)(cq + p.cq_off.cqes);
+    return true;
+}
+
+UringPoller::FdState& UringPoller::state_(int fd) {
+    assert(fd >= 0);
+    if(static_cast<size_t>(fd) >= fds_.size()) {
+        fds_.resize(fd + 1024);
+    }
+    return fds_[fd];
+}
+
+// 取一个空闲的 SQE，SQ 满了就先把已有的提交掉
+io_uring_sqe* UringPoller::getSqe_() {
+    unsigned tail = *sqTail_;
+    if(tail - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_) {
+        enter_(0, -1);
+        tail = *sqTail_;
+    }
+    unsigned idx = tail & *sqMask_;
+    io_uring_sqe* sqe = &sqes_[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqArray_[idx] = idx;
+    __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+    return sqe;
+}
+
+void UringPoller::armPoll_(int fd) {
+    FdState& st = state_(fd);
+    io_uring_sqe* sqe = getSqe_();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    // ONESHOT/ET 由这里自己处理，交给内核的只有真正的事件位
+    sqe->poll32_events = st.events & ~(EPOLLONESHOT | EPOLLET);
+    sqe->user_data = (uint64_t)st.gen << 32 | (uint32_t)fd;
+    st.armed = true;
+}
+
+void UringPoller::removePoll_(int fd) {
+    FdState& st = state_(fd);
+    if(!st.armed) {
+        return;
+    }
+    io_uring_sqe* sqe = getSqe_();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = (uint64_t)st.gen << 32 | (uint32_t)fd;
+    sqe->user_data = REMOVE_TAG;
+    st.armed = false;
+}
+
+bool UringPoller::addFd(int fd, uint32_t events) {
+    if(fd < 0) return false;
+    FdState& st = state_(fd);
+    if(st.registered) {
+        errno = EEXIST;
+        return false;
+    }
+    st.registered = true;
+    st.events = events;
+    st.gen++;
+    armPoll_(fd);
+    return true;
+}
+
+bool UringPoller::modFd(int fd, uint32_t events) {
+    if(fd < 0) return false;
+    FdState& st = state_(fd);
+    if(!st.registered) {
+        errno = ENOENT;
+        return false;
+    }
+    removePoll_(fd);  // 还挂着的话先撤掉
+    st.events = events;
+    st.gen++;
+    armPoll_(fd);
+    return true;
+}
+
+bool UringPoller::delFd(int fd) {
+    if(fd < 0) return false;
+    FdState& st = state_(fd);
+    if(!st.registered) {
+        errno = ENOENT;
+        return false;
+    }
+    // fd 关闭之后内核里的 poll 请求还持有文件引用，必须显式撤掉
+    removePoll_(fd);
+    st.registered = false;
+    st.gen++;
+    return true;
+}
+
+// 提交所有攒下来的 SQE，并等待至少 minComplete 个完成事件
+int UringPoller::enter_(unsigned minComplete, int timeoutMs) {
+    unsigned toSubmit = *sqTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if(toSubmit == 0 && minComplete == 0) {
+        return 0;
+    }
+    unsigned flags = 0;
+    io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    memset(&arg, 0, sizeof(arg));
+    if(minComplete > 0) {
+        flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+        if(timeoutMs >= 0) {
+            ts.tv_sec = timeoutMs / 1000;
+            ts.tv_nsec = (long long)(timeoutMs % 1000) * 1000000;
+            arg.ts = (uint64_t)(uintptr_t)&ts;
+        }
+    }
+    countSyscall_();
+    return io_uring_enter(ringFd_, toSubmit, minComplete, flags, flags ? &arg : nullptr, flags ? sizeof(arg) : 0);
+}
+
+int UringPoller::wait(int timeoutMs) {
+    events_.clear();
+    unsigned head = *cqHead_;
+    // CQ 里还有上一轮没取完的事件就不阻塞
+    bool ready = head != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    int ret = enter_(ready ? 0 : 1, timeoutMs);
+    if(ret < 0 && errno != ETIME && errno != EINTR && errno != EBUSY) {
+        return -1;
+    }
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    while(head != tail && events_.size() < maxEvent_) {
+        const io_uring_cqe& cqe = cqes_[head & *cqMask_];
+        head++;
+        if(cqe.user_data == REMOVE_TAG) {
+            continue;
+        }
+        int fd = (int)(uint32_t)cqe.user_data;
+        uint32_t gen = (uint32_t)(cqe.user_data >> 32);
+        FdState& st = state_(fd);
+        if(!st.registered || st.gen != gen || !st.armed) {
+            continue;  // 已经被 mod/del 过，过期的事件
+        }
+        st.armed = false;
+        struct epoll_event ev;
+        ev.data.fd = fd;
+        ev.events = cqe.res < 0 ? EPOLLERR : static_cast<uint32_t>(cqe.res);
+        events_.push_back(ev);
+        // 不是 ONESHOT 的 fd（监听socket、eventfd）自动重新注册，等同于水平触发
+        if(!(st.events & EPOLLONESHOT)) {
+            armPoll_(fd);
+        }
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+    return static_cast<int>(events_.size());
+}
+
+int UringPoller::getEventFd(size_t i) const {
+    assert(i < events_.size());
+    return events_[i].data.fd;
+}
+
+uint32_t UringPoller::getEvents(size_t i) const {
+    assert(i < events_.size());
+    return events_[i].events;
+}
@@ -0,0 +1,79 @@
+#ifndef URINGPOLLER_H
+#define URINGPOLLER_H
+
+#include <linux/io_uring.h> // io_uring_sqe, io_uring_cqe, IORING_*
+#include <sys/syscall.h> // SYS_io_uring_setup, SYS_io_uring_enter
+#include <sys/mman.h> // mmap
+#include <unistd.h> // close
+#include <assert.h>
+#include <vector>
+#include <errno.h>
+#include "poller.h"
+
+// 基于 io_uring 的 Poller，直接用系统调用，不依赖 liburing
+// addFd/modFd/delFd 只是往 SQ 里填 POLL_ADD/POLL_REMOVE，不进内核，
+// 统一在 wait() 里用一次 io_uring_enter 提交并等待完成事件。
+// 这样 EPOLLONESHOT 的重新注册不再各自花一次 epoll_ctl。
+class UringPoller : public Poller {
+public:
+    // maxEvent: 一次 wait() 最多返回的事件数
+    UringPoller(int maxEvent = 1024);
+    ~UringPoller() override;
+    // 初始化是否成功（内核不支持 io_uring 时失败）
+    bool isValid() const { return ringFd_ >= 0; }
+
+    bool addFd(int fd, uint32_t events) override;
+    bool modFd(int fd, uint32_t events) override;
+    bool delFd(int fd) override;
+    int wait(int timeoutMs = -1) override;
+
+    int getEventFd(size_t i) const override;
+    uint32_t getEvents(size_t i) const override;
+
+private:
+    // 每个 fd 的注册状态，下标就是 fd
+    struct FdState {
+        uint32_t events = 0;   // 注册的事件
+        uint32_t gen = 0;      // 每次 add/mod/del 加一，用来丢弃过期的完成事件
+        bool registered = false;
+        bool armed = false;    // 内核里是否有这个 fd 的 POLL_ADD 还没完成
+    };
+
+    static const uint64_t REMOVE_TAG = ~0ULL; // POLL_REMOVE 自己的完成事件，直接忽略
+
+    bool setup_(unsigned entries);
+    void release_();
+    io_uring_sqe* getSqe_();
+    void armPoll_(int fd);
+    void removePoll_(int fd);
+    int enter_(unsigned minComplete, int timeoutMs);
+    FdState& state_(int fd);
+
+    int ringFd_;
+    unsigned features_;
+
+    // SQ ring
+    void* sqRing_;
+    size_t sqRingSize_;
+    unsigned* sqHead_;
+    unsigned* sqTail_;
+    unsigned* sqMask_;
+    unsigned* sqArray_;
+    io_uring_sqe* sqes_;
+    size_t sqesSize_;
+    unsigned sqEntries_;
+
+    // CQ ring
+    void* cqRing_;
+    size_t cqRingSize_;
+    unsigned* cqHead_;
+    unsigned* cqTail_;
+    unsigned* cqMask_;
+    io_uring_cqe* cqes_;
+
+    std::vector<FdState> fds_;
+    std::vector<struct epoll_event> events_; // 本次 wait() 收集到的事件
+    size_t maxEvent_;
+};
+
+#endif // URINGPOLLER_H
@@ -3,16 +3,23 @@
 webServer::webServer(int port, int trigMode, int timeoutMS, 
                      bool OptLinger, int sqlPort, const char* sqlUser, 
                      const char* sqlPwd, const char* dbName, 
-                     int connPoolNum, int threadNum, bool openLog, 
-                     int logLevel, int logQueSize) :
+                     int connPoolNum, int threadNum, int reactorNum, int dispatchMode,
+                     int pollerType, bool openLog, int logLevel, int logQueSize) :
                      port_(port), openLinger_(OptLinger), timeoutMS_(timeoutMS), isClose_(false),
-      timer_(new HeapTimer()), threadpool_(new ThreadPool(threadNum)), epoller_(new Epoller())
+      dispatchMode_(dispatchMode), threadpool_(new ThreadPool(threadNum)), users_(new ConnSlab(MAX_FD)), nextReactor_(0),
+      lastReport_(Clock::now()), lastHandshakes_(0)
 {
     srcDir_ = getcwd(nullptr, 256); // 获取当前工作目录
     assert(srcDir_);
     strncat(srcDir_, "/resources/", 16); // 拼接资源目录
     HttpConn::userCount = 0;  // 初始化用户数量
     HttpConn::srcDir = srcDir_; // 设置资源目录
+    // 空闲超时是靠定时器执行的，Keep-Alive 头里写的就是这个值：没有定时器就不写，没配置就和处理超时一样
+    if(timeoutMS_ <= 0) {
+        HttpConn::keepAliveTimeout = 0;
+    } else if(HttpConn::keepAliveTimeout <= 0) {
+        HttpConn::keepAliveTimeout = timeoutMS_;
+    }
 
     // 是否打开日志标志
     if(openLog) {
@@ -28,18 +35,100 @@ webServer::webServer(int port, int trigMode, int timeoutMS,
     initEventMode_(trigMode);  // 初始化事件模式
     //  初始化数据库连接池
     SqlConnPool::instance()->init("localhost", sqlPort, sqlUser, sqlPwd, dbName, connPoolNum);
-    if(initSocket_()) { // 初始化socket
-        isClose_ = false;
-        LOG_INFO("Init socket success");
+
+    // reactorNum <= 0 时按 CPU 核数创建
+    if(reactorNum <= 0) {
+        reactorNum = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for(int i = 0; i < reactorNum; i++) {
+        reactors_.emplace_back(new Reactor());
+        reactors_[i]->id = i;
+        reactors_[i]->poller.reset(Poller::create(pollerType));
+        reactors_[i]->timer.reset(new HeapTimer());
+    }
+    if(dispatchMode_ == REUSEPORT) {
+        for(auto& reactor : reactors_) {
+            if(!initSocket_(reactor.get())) { // 初始化socket，每个 reactor 一个
+                LOG_ERROR("Init socket error");
+                isClose_ = true;
+                return;
+            }
+        }
     } else {
-        LOG_ERROR("Init socket error");
-        isClose_ = true;
+        // 只有 acceptor 监听，sub-reactor 通过 eventfd 接收新连接
+        acceptor_.reset(new Reactor());
+        acceptor_->id = -1;
+        acceptor_->poller.reset(Poller::create(pollerType));
+        acceptor_->timer.reset(new HeapTimer());
+        if(!initSocket_(acceptor_.get())) {
+            LOG_ERROR("Init socket error");
+            isClose_ = true;
+            return;
+        }
+        for(auto& reactor : reactors_) {
+            if(!initWakeup_(reactor.get())) {
+                LOG_ERROR("Init wakeup error");
+                isClose_ = true;
+                return;
+            }
+        }
+    }
+    LOG_INFO("Init socket success, reactorNum:%d, dispatchMode:%d, pollerType:%d", reactorNum, dispatchMode_, pollerType);
+    LOG_INFO("Keep-alive: max requests:%d, idle timeout:%dms, request timeout:%dms", HttpConn::keepAliveRequests,
+             HttpConn::keepAliveTimeout, timeoutMS_);
+    HttpArchive* archive = HttpArchive::instance();
+    if(archive->loaded()) {
+        LOG_INFO("Asset archive: files:%zu size:%zu warm:%.2fms rss:+%zuKB hugepages:%s(%zuKB)", archive->files(),
+                 archive->size(), archive->warmMs(), archive->rssBytes() >> 10, archive->hugepages() ? "on" : "off",
+                 archive->hugeBytes() >> 10);
+    }
+    if(HttpTls::instance()->enabled()) {
+        LOG_INFO("HTTPS on, kTLS offload requested (falls back to SSL_write if the kernel refuses)");
+    }
+    initWatcher_();
+}
+
+// 只有缓存了文件内容或者打开的文件才需要监视；失败了不影响服务，只是缓存不会自动更新（打开文件缓存还有有效期兜底）
+void webServer::initWatcher_() {
+    if(!HttpCache::instance()->enabled() && !HttpFileCache::instance()->enabled()) {
+        return;
+    }
+    watcher_.reset(new FileWatcher());
+    std::string srcDir = srcDir_;
+    bool ok = watcher_->init(srcDir, [srcDir](const std::string& path) {
+        if(path.empty()) {
+            HttpCache::instance()->clear();
+            HttpFileCache::instance()->clear();
+        } else {
+            HttpCache::instance()->erase(path);
+            HttpFileCache::instance()->erase(srcDir + path);  // 和 HttpResponse 里拼出来的完整路径一致
+        }
+    });
+    // inotify fd 和 eventfd 一样用水平触发
+    if(!ok || !reactors_[0]->poller->addFd(watcher_->fd(), EPOLLIN)) {
+        LOG_WARN("File watcher disabled, cached files will not be refreshed");
+        watcher_.reset();
     }
 }
 
 webServer::~webServer() {
-    close(listenFd_);
     isClose_ = true;
+    for(auto& t : reactorThreads_) {
+        if(t.joinable()) {
+            t.join();
+        }
+    }
+    if(acceptor_ && acceptor_->listenFd >= 0) {
+        close(acceptor_->listenFd);
+    }
+    for(auto& reactor : reactors_) {
+        if(reactor->listenFd >= 0) {
+            close(reactor->listenFd);
+        }
+        if(reactor->wakeupFd >= 0) {
+            close(reactor->wakeupFd);
+        }
+    }
     free(srcDir_);
     SqlConnPool::instance()->closePool();
 }
@@ -70,41 +159,136 @@ void webServer::initEventMode_(int trigMode) {
     HttpConn::isET = (connEvent_ & EPOLLET); 
 }
 
-// 
 void webServer::start(){
-    int timeMS = -1; // epoll_wait() 的超时时间为-1，表示永久阻塞
     if(!isClose_) {
         LOG_INFO("Server start");
     }
+    // reactor[0] 在当前线程运行，其余各起一个线程
+    for(size_t i = 1; i < reactors_.size(); i++) {
+        reactorThreads_.emplace_back(&webServer::loop_, this, reactors_[i].get());
+    }
+    if(acceptor_) {
+        reactorThreads_.emplace_back(&webServer::loop_, this, acceptor_.get());
+    }
+    if(!reactors_.empty()) {
+        loop_(reactors_[0].get());
+    }
+    for(auto& t : reactorThreads_) {
+        if(t.joinable()) {
+            t.join();
+        }
+    }
+}
+
+void webServer::loop_(Reactor* reactor){
+    int timeMS = -1; // epoll_wait() 的超时时间为-1，表示永久阻塞
     while(!isClose_) {
         if(timeoutMS_ > 0) {
-            timeMS = timer_->getNextTick(); // 获取定时器的超时时间
+            timeMS = reactor->timer->getNextTick(); // 获取定时器的超时时间
+        }
+        // reactor[0] 负责定期输出统计信息，所以最多阻塞一个统计周期
+        if(reactor->id == 0 && (timeMS < 0 || timeMS > STATS_INTERVAL_MS)) {
+            timeMS = STATS_INTERVAL_MS;
+        }
+        int eventCnt = reactor->poller->wait(timeMS); // 等待事件数目
+        if(eventCnt == 0) {
+            BufferPool::trim();  // 这个 reactor 闲下来了，突发时攒在池里的空闲段还掉一部分
         }
-        int eventCnt = epoller_->wait(timeMS); // 等待事件数目
         for(int i = 0; i < eventCnt; i++) {
-            int fd = epoller_->getEventFd(i); // 获取事件的文件描述符
-            uint32_t events = epoller_->getEvents(i); // 获取事件
-            if(fd == listenFd_) {
-                dealListen_(); // 处理监听事件
-            } else if(events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
-                assert(users_.count(fd) > 0);
-                closeConn_(&users_[fd]); // 关闭连接
+            int fd = reactor->poller->getEventFd(i); // 获取事件的文件描述符
+            uint32_t events = reactor->poller->getEvents(i); // 获取事件
+            if(fd == reactor->listenFd) {
+                dealListen_(reactor); // 处理监听事件
+                continue;
+            } else if(fd == reactor->wakeupFd) {
+                dealWakeup_(reactor); // 处理 acceptor 投递的新连接
+                continue;
+            } else if(reactor->id == 0 && watcher_ && fd == watcher_->fd()) {
+                watcher_->handle(); // 资源文件有变化
+                continue;
+            }
+            HttpConn* client = users_->get(fd); // 直接按 fd 下标取
+            if(!client || client->isClosed()) {
+                LOG_ERROR("Error: fd no exist");
+                continue;
+            }
+            assert(users_->owner(fd) == reactor->id);
+            if(events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                closeConn_(reactor, client); // 关闭连接
             } else if(events & EPOLLIN) {
-                if(users_.count(fd) > 0) {
-                    onRead_(&users_[fd]); // 读事件
-                } else {
-                    LOG_ERROR("Error: fd no exist");
-                }
+                onRead_(reactor, client); // 读事件
             } else if(events & EPOLLOUT) {
-                if(users_.count(fd) > 0) {
-                    onWrite_(&users_[fd]); // 写事件
-                } else {
-                    LOG_ERROR("Error: fd no exist");
-                }
+                onWrite_(reactor, client); // 写事件
             } else {
                 LOG_ERROR("Error: something else");
             }
         }
+        if(reactor->id == 0 && std::chrono::duration_cast<MS>(Clock::now() - lastReport_).count() >= STATS_INTERVAL_MS) {
+            reportStats_();
+        }
+    }
+}
+
+std::vector<int> webServer::reactorConnCounts() const {
+    std::vector<int> counts;
+    for(auto& reactor : reactors_) {
+        counts.push_back(reactor->connCount);
+    }
+    return counts;
+}
+
+// 输出每个 reactor 的连接数，用来观察负载是否均衡
+void webServer::reportStats_() {
+    Clock::time_point now = Clock::now();
+    double seconds = std::chrono::duration<double>(now - lastReport_).count();
+    lastReport_ = now;
+    std::string line;
+    for(int cnt : reactorConnCounts()) {
+        line += std::to_string(cnt) + " ";
+    }
+    uint64_t syscalls = 0;
+    for(auto& reactor : reactors_) {
+        syscalls += reactor->poller->syscalls();
+    }
+    LOG_INFO("Reactor conns: [ %s] total:%d, poller syscalls:%llu", line.c_str(), (int)HttpConn::userCount,
+             (unsigned long long)syscalls);
+    LOG_INFO("Bytes sent: sendfile:%llu writev:%llu, write quantum yields:%llu", (unsigned long long)HttpConn::sendfileBytes,
+             (unsigned long long)HttpConn::writevBytes, (unsigned long long)HttpConn::writeYields);
+    uint64_t conns = HttpConn::connections;
+    LOG_INFO("Keep-alive: connections:%llu requests:%llu (%.1f per conn), closed at max:%llu idle:%llu",
+             (unsigned long long)conns, (unsigned long long)HttpConn::requests,
+             conns ? (double)HttpConn::requests / conns : 0.0, (unsigned long long)HttpConn::keepAliveCapped,
+             (unsigned long long)HttpConn::idleTimeouts);
+    LOG_INFO("Buffers: live:%zuKB pooled:%zuKB trimmed:%lluKB, peak per conn:%zuB, conn object:%zuB",
+             BufferPool::liveBytes() >> 10, BufferPool::pooledBytes() >> 10,
+             (unsigned long long)(BufferPool::trimmedBytes() >> 10), (size_t)HttpConn::peakFootprint,
+             sizeof(HttpConn) + sizeof(HttpResponse));
+    HttpCache* cache = HttpCache::instance();
+    if(cache->enabled()) {
+        LOG_INFO("Response cache: hit:%llu miss:%llu evict:%llu entries:%zu bytes:%zu/%zu",
+                 (unsigned long long)cache->hits(), (unsigned long long)cache->misses(),
+                 (unsigned long long)cache->evictions(), cache->entries(), cache->bytes(), cache->capacity());
+    }
+    HttpFileCache* files = HttpFileCache::instance();
+    if(files->enabled()) {
+        LOG_INFO("Open file cache: hit:%llu (negative:%llu) miss:%llu evict:%llu entries:%zu",
+                 (unsigned long long)files->hits(), (unsigned long long)files->negativeHits(),
+                 (unsigned long long)files->misses(), (unsigned long long)files->evictions(), files->entries());
+    }
+    if(watcher_) {
+        LOG_INFO("File watcher: dirs:%zu events:%llu invalidations:%llu rescans:%llu", watcher_->watches(),
+                 (unsigned long long)watcher_->events(), (unsigned long long)watcher_->invalidations(),
+                 (unsigned long long)watcher_->rescans());
+    }
+    HttpTls* tls = HttpTls::instance();
+    if(tls->enabled()) {
+        uint64_t handshakes = tls->handshakes();
+        LOG_INFO("TLS: handshakes:%llu (%.1f/s) failed:%llu, ktls tx:%llu rx:%llu, encrypted bytes kernel:%llu user:%llu",
+                 (unsigned long long)handshakes, (handshakes - lastHandshakes_) / seconds,
+                 (unsigned long long)tls->failures(), (unsigned long long)tls->ktlsTx(),
+                 (unsigned long long)tls->ktlsRx(), (unsigned long long)tls->kernelBytes(),
+                 (unsigned long long)tls->userBytes());
+        lastHandshakes_ = handshakes;
     }
 }
 
@@ -118,86 +302,183 @@ void webServer::sendError_(int fd, const char* info) {
     close(fd);
 }
 
-void webServer::closeConn_(HttpConn* client) {
+void webServer::closeConn_(Reactor* reactor, HttpConn* client) {
     assert(client);
-    LOG_INFO("Client[%d] quit!", client->getFd());
-    epoller_->delFd(client->getFd());
+    if(client->isClosed()) {
+        return;
+    }
+    int fd = client->getFd();
+    LOG_INFO("Reactor[%d] Client[%d] quit!", reactor->id, fd);
+    reactor->poller->delFd(fd);
+    // 必须在 close(fd) 之前释放槽位：fd 一关闭就可能被别的 reactor 复用
+    users_->release(fd);
     client->httpclose();
+    reactor->connCount--;
+}
+
+void webServer::onTimeout_(Reactor* reactor, int fd, uint32_t gen) {
+    HttpConn* client = users_->get(fd, gen);
+    if(client) {
+        if(client->keepAliveIdle()) {
+            HttpConn::idleTimeouts.fetch_add(1, std::memory_order_relaxed);
+        }
+        closeConn_(reactor, client);
+    }
 }
 
-void webServer::addClient_(int fd, sockaddr_in addr) {
+void webServer::addClient_(Reactor* reactor, int fd, sockaddr_in addr) {
     assert(fd > 0);
-    users_[fd].init(fd, addr);
+    uint32_t gen = 0;
+    HttpConn* client = users_->acquire(fd, reactor->id, &gen);
+    client->init(fd, addr);
     if(timeoutMS_ > 0) {
-        timer_->add(fd, timeoutMS_, std::bind(&webServer::closeConn_, this, &users_[fd]));
+        // 回调只记 (fd, generation)，fd 被复用后旧的定时器不会误关新连接
+        reactor->timer->add(fd, timeoutMS_, std::bind(&webServer::onTimeout_, this, reactor, fd, gen));
     }
-    epoller_->addFd(fd, EPOLLIN | connEvent_);
+    reactor->poller->addFd(fd, EPOLLIN | connEvent_);
     setFdNonblock(fd);
-    LOG_INFO("Client[%d] in!", users_[fd].getFd());
+    if(!acceptor_) {
+        reactor->connCount++; // acceptor 模式在投递时已经计数
+    }
+    LOG_INFO("Reactor[%d] Client[%d] in, conns:%d", reactor->id, client->getFd(), (int)reactor->connCount);
 }
 
-void webServer::dealListen_() {
+void webServer::dealListen_(Reactor* reactor) {
     struct sockaddr_in addr;
     socklen_t len = sizeof(addr);
     do {
-        int fd = accept(listenFd_, (struct sockaddr*)&addr, &len);
+        int fd = accept(reactor->listenFd, (struct sockaddr*)&addr, &len);
         if(fd <= 0) {
             return;
         } 
         // 达到最大连接数，直接关闭新的连接, 都是 httpCOnn的静态变量
-        else if(HttpConn::userCount >= MAX_FD) {
+        else if(HttpConn::userCount >= MAX_FD || fd >= MAX_FD) {
             sendError_(fd, "Server busy!");
             LOG_WARN("Clients is full!");
             return;
         }
-        addClient_(fd, addr);
+        if(!acceptor_) {
+            addClient_(reactor, fd, addr);
+            continue;
+        }
+        // acceptor 模式：选一个 sub-reactor，投递到它的队列里再唤醒它
+        Reactor* target = pickReactor_();
+        if(!target->pending->push({fd, addr})) {
+            sendError_(fd, "Server busy!");
+            LOG_WARN("Reactor[%d] pending queue is full!", target->id);
+            continue;
+        }
+        target->connCount++; // 投递时就计数，最少连接策略才能看到还没被处理的连接
+        if(!target->notified.exchange(true)) {
+            uint64_t one = 1;
+            ::write(target->wakeupFd, &one, sizeof(one));
+        }
     } while(listenEvent_ & EPOLLET);
 }
 
+webServer::Reactor* webServer::pickReactor_() {
+    if(dispatchMode_ == LEAST_CONN) {
+        Reactor* target = reactors_[0].get();
+        for(auto& reactor : reactors_) {
+            if(reactor->connCount < target->connCount) {
+                target = reactor.get();
+            }
+        }
+        return target;
+    }
+    Reactor* target = reactors_[nextReactor_].get(); // ROUND_ROBIN
+    nextReactor_ = (nextReactor_ + 1) % reactors_.size();
+    return target;
+}
+
+void webServer::dealWakeup_(Reactor* reactor) {
+    uint64_t cnt = 0;
+    ::read(reactor->wakeupFd, &cnt, sizeof(cnt));
+    // 先清标志再取队列，保证标志清掉之后投递的连接一定会再唤醒一次
+    reactor->notified = false;
+    NewConn conn;
+    while(reactor->pending->pop(conn)) {
+        addClient_(reactor, conn.fd, conn.addr);
+    }
+}
+
 
-void webServer::dealRead_(HttpConn* client) {
+// 线程池任务同样只带 (fd, generation)，执行时连接已经换人就什么都不做
+void webServer::dealRead_(Reactor* reactor, HttpConn* client) {
     assert(client);
-    extTimer_(client);
-    threadpool_->addTask(std::bind(&webServer::onRead_, this, client));
+    extTimer_(reactor, client);
+    int fd = client->getFd();
+    uint32_t gen = users_->gen(fd);
+    client->handoff();  // 交给工作线程，reactor 不再碰这个连接，直到它重新注册
+    threadpool_->addTask([this, reactor, fd, gen]() {
+        HttpConn* client = users_->get(fd, gen);
+        if(client) {
+            onRead_(reactor, client);
+        }
+    });
 }
 
-void webServer::dealWrite_(HttpConn* client) {
+void webServer::dealWrite_(Reactor* reactor, HttpConn* client) {
     assert(client);
-    extTimer_(client);
-    threadpool_->addTask(std::bind(&webServer::onWrite_, this, client));
+    extTimer_(reactor, client);
+    int fd = client->getFd();
+    uint32_t gen = users_->gen(fd);
+    client->handoff();
+    threadpool_->addTask([this, reactor, fd, gen]() {
+        HttpConn* client = users_->get(fd, gen);
+        if(client) {
+            onWrite_(reactor, client);
+        }
+    });
 }
 
-void webServer::extTimer_(HttpConn* client){
+void webServer::extTimer_(Reactor* reactor, HttpConn* client){
     assert(client);
     if(timeoutMS_ >0){
-        timer_->adjust(client->getFd(),timeoutMS_);
+        reactor->timer->adjust(client->getFd(),timeoutMS_);
     }
 }
 
-void webServer::onRead_(HttpConn* client) {
+void webServer::onRead_(Reactor* reactor, HttpConn* client) {
     assert(client);
     int ret = -1;
     int readErrno = 0;
     ret = client->read(&readErrno);
     if(ret <= 0 && readErrno != EAGAIN) {
-        closeConn_(client);
+        closeConn_(reactor, client);
         return;
     }
-    onProcess(client);
+    if(ret > 0) {
+        extTimer_(reactor, client);  // 收到请求数据，按处理请求的超时算
+    }
+    onProcess(reactor, client);
 }
 
-void webServer::onProcess(HttpConn* client) {
+void webServer::onProcess(Reactor* reactor, HttpConn* client) {
     // 处理报文，并接受响应
     if(client->process()) {
         // 读完了，改为写事件
-        epoller_->modFd(client->getFd(), connEvent_ | EPOLLOUT);
+        rearm_(reactor, client, EPOLLOUT);
     } else {
+        if(client->keepAliveIdle()) {
+            // 响应都发完了，等下一个请求：还掉缓冲区等占着的内存，换成空闲超时
+            client->shrink();
+            if(timeoutMS_ > 0) {
+                reactor->timer->adjust(client->getFd(), HttpConn::keepAliveTimeout);
+            }
+        }
         // 反之还是读事件
-        epoller_->modFd(client->getFd(), connEvent_ | EPOLLIN);
+        rearm_(reactor, client, EPOLLIN);
     }
 }
 
-void webServer::onWrite_(HttpConn* client) {
+// 重新注册之后下一个事件可能马上在别的线程里处理（线程池模式），所以先交出连接，之后不能再碰它
+void webServer::rearm_(Reactor* reactor, HttpConn* client, uint32_t events) {
+    client->handoff();
+    reactor->poller->modFd(client->getFd(), connEvent_ | events);
+}
+
+void webServer::onWrite_(Reactor* reactor, HttpConn* client) {
     assert(client);
     int ret = -1;
     int writeErrno = 0;
@@ -206,21 +487,24 @@ void webServer::onWrite_(HttpConn* client) {
         // 已经发送完毕
         if(client->isKeepAlive()) {
             // 写完了，转为监听，就是读事件
-            onProcess(client);
+            onProcess(reactor, client);
             return;
         }
-    } else if(ret < 0) {
-        if(writeErrno == EAGAIN) {
-            // 继续发送
-            epoller_->modFd(client->getFd(), connEvent_ | EPOLLOUT);
-            return;
+    } else if(ret > 0 || writeErrno == EAGAIN) {
+        // socket 缓冲区满了，或者用完了这次的写额度：重新注册 EPOLLOUT 继续发送。
+        // socket 仍然可写时会在下一轮 wait 里立刻就绪，排在这一轮其他就绪连接的后面，各连接轮流发
+        if(ret > 0) {
+            extTimer_(reactor, client);  // 还在发数据，不算空闲
         }
+        rearm_(reactor, client, EPOLLOUT);
+        return;
     }
-    closeConn_(client);
+    closeConn_(reactor, client);
 }
 
-// 创建监听fd,只创建一个，后续的由系统在服务器接受连接请求时，自动创建的
-bool webServer::initSocket_(){
+// 创建监听fd,每个 reactor 一个，后续的由系统在服务器接受连接请求时，自动创建的
+bool webServer::initSocket_(Reactor* reactor){
+    int listenFd = -1;
     int ret;
     struct sockaddr_in addr;
     if(port_ > 65535 || port_ < 1024){
@@ -241,14 +525,14 @@ bool webServer::initSocket_(){
             optLinger.l_linger = 1;  // 超时时间设置为 1s
         }
     
-        listenFd_ = socket(AF_INET,SOCK_STREAM ,0);
-        if(listenFd_ < 0){
+        listenFd = socket(AF_INET,SOCK_STREAM ,0);
+        if(listenFd < 0){
             LOG_ERROR("create socket error!,port is %d", port_);
             return false;
         }
-        ret = setsockopt(listenFd_,SOL_SOCKET,SO_LINGER,&optLinger,sizeof(optLinger));
+        ret = setsockopt(listenFd,SOL_SOCKET,SO_LINGER,&optLinger,sizeof(optLinger));
         if(ret < 0){
-            close(listenFd_);
+            close(listenFd);
             LOG_ERROR("init linger error!,port is %d", port_);
             return false;
         }
@@ -256,37 +540,62 @@ bool webServer::initSocket_(){
     int optVal = 1;
     // 端口复用，只有最后一个套接字会正常接受数据
     // 设置socket选项，允许端口复用
-    ret = setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, (const void*)&optVal, sizeof(int));
+    ret = setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, (const void*)&optVal, sizeof(int));
     if(ret == -1){
         LOG_ERROR("set socket setsockopt error !");
-        close(listenFd_);
+        close(listenFd);
         return false;
     }
+    // 多个 reactor 各自 bind 同一端口，内核按四元组哈希把连接分给不同的监听socket
+    if(dispatchMode_ == REUSEPORT && reactors_.size() > 1) {
+        ret = setsockopt(listenFd, SOL_SOCKET, SO_REUSEPORT, (const void*)&optVal, sizeof(int));
+        if(ret == -1){
+            LOG_ERROR("set SO_REUSEPORT error !");
+            close(listenFd);
+            return false;
+        }
+    }
 
     // 绑定
-    ret = bind(listenFd_,(struct sockaddr*)&addr,sizeof(addr));
+    ret = bind(listenFd,(struct sockaddr*)&addr,sizeof(addr));
     if(ret < 0){
         LOG_ERROR("Bind Port:%d error!", port_);
-        close(listenFd_);
+        close(listenFd);
         return false;
     }
 
     // 监听
-    ret = listen(listenFd_,6);  // 最多有6个连接同时等待接受
+    ret = listen(listenFd,6);  // 最多有6个连接同时等待接受
     if(ret < 0){
         LOG_ERROR("Listen port:%d error!", port_);
-        close(listenFd_);
+        close(listenFd);
         return false;   
     }
 
-    ret = epoller_-> addFd(listenFd_,listenEvent_|EPOLLIN); // 加入epoller
+    ret = reactor->poller->addFd(listenFd,listenEvent_|EPOLLIN); // 加入poller
     if(ret == 0){
         LOG_ERROR("Add listen error!");
-        close(listenFd_);
+        close(listenFd);
+        return false;
+    }
+    setFdNonblock(listenFd);
+    reactor->listenFd = listenFd;
+    LOG_INFO("Reactor[%d] server port:%d", reactor->id, port_);
+    return true;
+}
+
+bool webServer::initWakeup_(Reactor* reactor) {
+    reactor->wakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(reactor->wakeupFd < 0) {
+        LOG_ERROR("Reactor[%d] create eventfd error!", reactor->id);
+        return false;
+    }
+    reactor->pending.reset(new LockFreeQueue<NewConn>(PENDING_QUEUE_SIZE));
+    // eventfd 用水平触发，不能加 EPOLLONESHOT
+    if(!reactor->poller->addFd(reactor->wakeupFd, EPOLLIN)) {
+        LOG_ERROR("Reactor[%d] add eventfd error!", reactor->id);
         return false;
     }
-    setFdNonblock(listenFd_);
-    LOG_INFO("server port:%d",port_);
     return true;
 }
 
@@ -1,64 +1,115 @@
 #ifndef WEBSERVER_H
 #define WEBSERVER_H
 #include <unordered_map>
+#include <vector>
+#include <thread>
+#include <atomic>
 #include <fcntl.h>       // fcntl()
 #include <unistd.h>      // close()
 #include <assert.h>
 #include <errno.h>
 #include <sys/socket.h>
+#include <sys/eventfd.h> // eventfd()
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
-#include "epoller.h"
+#include "poller.h"
+#include "connslab.h"
+#include "filewatcher.h"
 #include "../time/heaptimer.h"
 
 #include "../log/log.h"
 #include "../pool/sqlconnpool.h"
 #include "../pool/threadpool.h"
+#include "../pool/lockfreequeue.h"
 
 #include "../http/httpConn.h"
 
 class webServer{
 public:
+    // 新连接分配给 reactor 的方式
+    enum DispatchMode {
+        REUSEPORT = 0,  // 每个 reactor 一个 SO_REUSEPORT 监听socket，由内核哈希分配
+        ROUND_ROBIN,    // 独立的 acceptor 线程轮询分配
+        LEAST_CONN,     // 独立的 acceptor 线程分给当前连接数最少的 reactor
+    };
+
     // 初始化
     webServer(int port, int trigMode, int timeoutMS, 
               bool OptLinger, int sqlPort, const char* sqlUser, 
               const char* sqlPwd, const char* dbName, 
-              int connPoolNum, int threadNum,
-              bool openLog, int logLevel, int logQueSize);
+              int connPoolNum, int threadNum, int reactorNum, int dispatchMode,
+              int pollerType, bool openLog, int logLevel, int logQueSize);
     ~webServer();
     void start();
+    // 每个 reactor 当前的连接数
+    std::vector<int> reactorConnCounts() const;
 private:
-    bool initSocket_(); // 初始化socket
+    // acceptor 交给 sub-reactor 的新连接
+    struct NewConn {
+        int fd;
+        sockaddr_in addr;
+    };
+
+    // 一个 reactor 就是一个独立的事件循环：自己的 poller、定时器，以及 slab 里属于它的连接。
+    // REUSEPORT 模式下每个 reactor 有自己的监听socket；
+    // acceptor 模式下 reactor 没有监听socket，新连接从 pending 队列里取，由 wakeupFd 唤醒
+    struct Reactor {
+        int id;
+        int listenFd = -1; // 监听文件描述符
+        int wakeupFd = -1; // eventfd，acceptor 投递新连接后写它唤醒 epoll_wait
+        std::unique_ptr<Poller> poller; // epoll 或 io_uring
+        std::unique_ptr<HeapTimer> timer; // 定时器
+        std::unique_ptr<LockFreeQueue<NewConn>> pending; // acceptor -> reactor 的新连接队列
+        std::atomic<bool> notified{false}; // 是否已经写过 wakeupFd 且还没被处理，避免重复唤醒
+        std::atomic<int> connCount{0}; // 当前连接数
+    };
+
+    bool initSocket_(Reactor* reactor); // 初始化socket
+    bool initWakeup_(Reactor* reactor); // 初始化 eventfd 和新连接队列
     void initEventMode_(int trigMode); // 初始化事件模式
-    void addClient_(int fd, sockaddr_in addr); // 添加客户端
-    void dealListen_(); // 处理监听事件
-    void dealWrite_(HttpConn* client); // 处理写事件
-    void dealRead_(HttpConn* client); // 处理读事件
+    void initWatcher_(); // 监视资源目录，文件变了让缓存失效
+    void loop_(Reactor* reactor); // 事件循环
+    void reportStats_(); // 输出统计信息
+    void addClient_(Reactor* reactor, int fd, sockaddr_in addr); // 添加客户端
+    void dealListen_(Reactor* reactor); // 处理监听事件
+    Reactor* pickReactor_(); // acceptor 按策略选一个 sub-reactor
+    void dealWakeup_(Reactor* reactor); // 处理 acceptor 投递过来的新连接
+    void dealWrite_(Reactor* reactor, HttpConn* client); // 处理写事件
+    void dealRead_(Reactor* reactor, HttpConn* client); // 处理读事件
     void sendError_(int fd, const char*info); // 发送错误信息
-    void extTimer_(HttpConn* client); // 延长定时器
-    void closeConn_(HttpConn* client); // 关闭连接
-    void onRead_(HttpConn* client); // 读事件
-    void onWrite_(HttpConn* client); // 写事件
-    void onProcess(HttpConn* client);
+    void extTimer_(Reactor* reactor, HttpConn* client); // 延长定时器
+    void closeConn_(Reactor* reactor, HttpConn* client); // 关闭连接
+    void onTimeout_(Reactor* reactor, int fd, uint32_t gen); // 定时器超时，校验 generation 后关闭
+    void onRead_(Reactor* reactor, HttpConn* client); // 读事件
+    void onWrite_(Reactor* reactor, HttpConn* client); // 写事件
+    void rearm_(Reactor* reactor, HttpConn* client, uint32_t events); // 交出连接，重新注册 EPOLLIN/EPOLLOUT
+    void onProcess(Reactor* reactor, HttpConn* client);
 
     static const int MAX_FD = 65536; // 最大文件描述符
+    static const int STATS_INTERVAL_MS = 10000; // 统计信息输出间隔
+    static const int PENDING_QUEUE_SIZE = 4096; // 每个 sub-reactor 待接收新连接队列的容量
     static int setFdNonblock(int fd); // 设置非阻塞
 
 
     int port_; // 端口
     bool openLinger_; // 是否开启优雅关闭
     int timeoutMS_; // 超时时间
-    bool isClose_; // 是否关闭
-    int listenFd_; // 监听文件描述符
+    std::atomic<bool> isClose_; // 是否关闭，析构时写，各个 reactor 和 acceptor 线程在事件循环里读
+    int dispatchMode_; // 新连接分配方式
     char* srcDir_; // 资源目录
     uint32_t listenEvent_; // 监听事件
     uint32_t connEvent_; // 连接事件
 
-    std::unique_ptr<HeapTimer> timer_; // 定时器
     std::unique_ptr<ThreadPool> threadpool_; // 线程池
-    std::unique_ptr<Epoller> epoller_; // epoll
-    std::unordered_map<int, HttpConn> users_; // 用户
+    std::unique_ptr<ConnSlab> users_; // 用户，按 fd 下标存放，所有 reactor 共用
+    std::vector<std::unique_ptr<Reactor>> reactors_; // reactor[0] 跑在调用 start() 的线程上
+    std::vector<std::thread> reactorThreads_; // 其余 reactor 以及 acceptor 的线程
+    std::unique_ptr<Reactor> acceptor_; // acceptor 模式下只负责 accept 的 main-reactor
+    std::unique_ptr<FileWatcher> watcher_; // inotify，放在 reactor[0] 的 poller 里
+    size_t nextReactor_; // 轮询分配的下一个 reactor
+    Clock::time_point lastReport_; // 上次输出统计信息的时间
+    uint64_t lastHandshakes_; // 上次输出时的 TLS 握手数，用来算握手速率
 };
 
-#endif // WEBSERVER_H
\ No newline at end of file
+#endif // WEBSERVER_H
@@ -60,7 +60,10 @@ void HeapTimer::del_(size_t i) {
 void HeapTimer::adjust(int id, int newExpires) {
     assert(!heap.empty() && ref.count(id) > 0);
     heap[ref[id]].expires = Clock::now() + MS(newExpires);
-    siftdown_(ref[id], heap.size()); // 因为时间变大了，所以向下调整
+    // 一般是延长，向下调整；换成更短的空闲超时时要向上调整
+    if(!siftdown_(ref[id], heap.size())) {
+        siftup_(ref[id]);
+    }
 }
 
 // 添加一个定时器
@@ -0,0 +1,205 @@
+// 把资源目录打成一个资源包，服务器用 -a 加载之后所有静态文件都从内存发
+// 用法: packassets <资源目录> <输出文件>
+// 预压缩的 xxx.br / xxx.gz 作为 xxx 的对应编码版本打进去，没有的话文本类文件在这里压缩好。
+// MIME 类型、ETag 的算法和服务器从文件发送时完全一样，切换模式不会让客户端缓存失效。
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "../http/httpArchive.h"
+#include "../http/httpEncoding.h"
+#include "../http/httpResponse.h"
+
+struct Asset {
+    std::string path;  // 以 / 开头
+    std::string type;
+    std::string lastModified;
+    int64_t mtime;
+    std::string body[HttpArchive::VARIANTS];
+    std::string etag[HttpArchive::VARIANTS];  // 空表示没有这个版本
+};
+
+static bool readFile(const std::string& file, std::string& out, struct stat* st) {
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = fstat(fd, st) == 0;
+    out.resize(ok ? st->st_size : 0);
+    size_t done = 0;
+    while (ok && done < out.size()) {
+        ssize_t n = read(fd, &out[done], out.size() - done);
+        ok = n > 0;
+        done += ok ? n : 0;
+    }
+    close(fd);
+    return ok;
+}
+
+static bool readable(const std::string& file, struct stat* st) {
+    return stat(file.c_str(), st) == 0 && S_ISREG(st->st_mode) && (st->st_mode & S_IROTH);
+}
+
+static void walk(const std::string& root, const std::string& dir, std::vector<std::string>& paths) {
+    DIR* dp = opendir((root + dir).c_str());
+    if (!dp) {
+        return;
+    }
+    while (struct dirent* ent = readdir(dp)) {
+        if (ent->d_name[0] == '.') {
+            continue;
+        }
+        std::string path = dir + "/" + ent->d_name;
+        struct stat st;
+        if (stat((root + path).c_str(), &st) < 0) {
+            continue;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            walk(root, path, paths);
+        } else if (S_ISREG(st.st_mode)) {
+            paths.push_back(path);
+        }
+    }
+    closedir(dp);
+}
+
+static bool isVariant(const std::string& root, const std::string& path) {
+    struct stat st;
+    size_t n = path.size();
+    return n > 3 && (path.compare(n - 3, 3, ".br") == 0 || path.compare(n - 3, 3, ".gz") == 0)
+        && stat((root + path.substr(0, n - 3)).c_str(), &st) == 0;
+}
+
+static bool loadAsset(const std::string& root, const std::string& path, Asset& a) {
+    struct stat st;
+    std::string file = root + path;
+    if (!readable(file, &st)) {
+        fprintf(stderr, "skip %s: not world-readable\n", path.c_str());  // 服务器对它回 403，包里不放
+        return false;
+    }
+    if (!readFile(file, a.body[HttpEncoding::IDENTITY], &st)) {
+        fprintf(stderr, "skip %s: read error\n", path.c_str());
+        return false;
+    }
+    a.path = path;
+    a.type = std::string(HttpResponse::fileType(path));
+    a.mtime = st.st_mtime;
+    a.lastModified = HttpResponse::httpDate(st.st_mtime);
+    a.etag[HttpEncoding::IDENTITY] = HttpResponse::makeETag(st, HttpEncoding::IDENTITY);
+    const std::string& raw = a.body[HttpEncoding::IDENTITY];
+    for (HttpEncoding::ENCODING enc : {HttpEncoding::GZIP, HttpEncoding::BR}) {
+        struct stat sst;
+        std::string sibling = file + std::string(HttpEncoding::suffix(enc));
+        if (readable(sibling, &sst) && readFile(sibling, a.body[enc], &sst)) {
+            a.etag[enc] = HttpResponse::makeETag(sst, enc);
+        } else if (HttpEncoding::compressible(a.type) && raw.size() >= HttpEncoding::MIN_SIZE
+                   && HttpEncoding::compress(enc, raw.data(), raw.size(), a.body[enc], true) && a.body[enc].size() < raw.size()) {
+            a.etag[enc] = HttpResponse::makeETag(st, enc);
+        } else {
+            a.body[enc].clear();  // 压缩了反而更大，不放这个版本
+        }
+    }
+    return true;
+}
+
+static HttpArchive::Ref addString(std::string& strings, size_t base, const std::string& s) {
+    HttpArchive::Ref ref = {static_cast<uint32_t>(base + strings.size()), static_cast<uint32_t>(s.size())};
+    strings += s;
+    return ref;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <resources dir> <output>\n", argv[0]);
+        return 1;
+    }
+    std::string root = argv[1];
+    while (root.size() > 1 && root.back() == '/') {
+        root.pop_back();
+    }
+    std::vector<std::string> paths;
+    walk(root, "", paths);
+    std::sort(paths.begin(), paths.end());
+    std::vector<Asset> assets;
+    for (auto& path : paths) {
+        Asset a;
+        if (!isVariant(root, path) && loadAsset(root, path, a)) {
+            assets.push_back(std::move(a));
+        }
+    }
+
+    // Header | Entry[count] | 字符串区 | 数据区
+    size_t indexOff = sizeof(HttpArchive::Header);
+    size_t stringsOff = indexOff + assets.size() * sizeof(HttpArchive::Entry);
+    std::vector<HttpArchive::Entry> entries(assets.size());
+    std::string strings;
+    for (size_t i = 0; i < assets.size(); i++) {
+        HttpArchive::Entry& e = entries[i];
+        memset(&e, 0, sizeof(e));
+        e.path = addString(strings, stringsOff, assets[i].path);
+        e.type = addString(strings, stringsOff, assets[i].type);
+        e.lastModified = addString(strings, stringsOff, assets[i].lastModified);
+        e.mtime = assets[i].mtime;
+        for (int v = 0; v < HttpArchive::VARIANTS; v++) {
+            if (!assets[i].etag[v].empty()) {
+                e.variants[v].etag = addString(strings, stringsOff, assets[i].etag[v]);
+            }
+        }
+    }
+    size_t dataOff = (stringsOff + strings.size() + HttpArchive::DATA_ALIGN - 1) / HttpArchive::DATA_ALIGN * HttpArchive::DATA_ALIGN;
+    size_t size = dataOff;
+    size_t variants = 0;
+    for (size_t i = 0; i < assets.size(); i++) {
+        for (int v = 0; v < HttpArchive::VARIANTS; v++) {
+            if (assets[i].etag[v].empty()) {
+                continue;
+            }
+            size = (size + 63) & ~size_t(63);  // 每段按缓存行对齐
+            entries[i].variants[v].off = size;
+            entries[i].variants[v].len = assets[i].body[v].size();
+            size += assets[i].body[v].size();
+            variants += v != HttpEncoding::IDENTITY;
+        }
+    }
+
+    std::string out(size, '\0');
+    HttpArchive::Header header = {};
+    memcpy(header.magic, HttpArchive::MAGIC, sizeof(header.magic));
+    header.version = HttpArchive::VERSION;
+    header.count = static_cast<uint32_t>(assets.size());
+    header.indexOff = indexOff;
+    header.dataOff = dataOff;
+    header.size = size;
+    memcpy(&out[0], &header, sizeof(header));
+    if (!entries.empty()) {
+        memcpy(&out[indexOff], entries.data(), entries.size() * sizeof(HttpArchive::Entry));
+    }
+    memcpy(&out[stringsOff], strings.data(), strings.size());
+    for (size_t i = 0; i < assets.size(); i++) {
+        for (int v = 0; v < HttpArchive::VARIANTS; v++) {
+            if (!assets[i].etag[v].empty()) {
+                memcpy(&out[entries[i].variants[v].off], assets[i].body[v].data(), assets[i].body[v].size());
+            }
+        }
+    }
+
+    // 先写临时文件再改名，正在用旧包启动的服务器不会读到一半的文件
+    std::string tmp = std::string(argv[2]) + ".tmp";
+    FILE* fp = fopen(tmp.c_str(), "wb");
+    if (!fp || fwrite(out.data(), 1, out.size(), fp) != out.size() || fclose(fp) != 0) {
+        fprintf(stderr, "write %s failed\n", tmp.c_str());
+        return 1;
+    }
+    if (rename(tmp.c_str(), argv[2]) < 0) {
+        fprintf(stderr, "rename to %s failed\n", argv[2]);
+        return 1;
+    }
+    printf("packed %zu files (%zu compressed variants), %zu bytes -> %s\n", assets.size(), variants, size, argv[2]);
+    return 0;
+}
@@ -1,5 +1,9 @@
 #include "../src/log/log.h"
 #include "../src/pool/threadpool.h"
+#include "../src/http/httpScanner.h"
+#include <algorithm>
+#include <chrono>
+#include <string>
 
 // level=3时，当 i>=3 才被记录，所以level为3时， 3 输出10次
 // level=2时,  2 3各10次，依次类推 debug 10次， info 20次 warn 30次 error 40次，总共100次
@@ -34,8 +38,142 @@ void testThreadPool() {
     getchar(); // 输入之后才会往下走
 }
 
+// 请求解析分隔符扫描的微基准：原来的 std::search 和 HttpScanner（SIMD）对比
+// 请求带一个 4KB 的 Cookie 和一个长 User-Agent，模拟线上的大请求头
+void benchScanner() {
+    std::string req = "GET /index.html HTTP/1.1\r\nHost: localhost:1316\r\n";
+    req += "User-Agent: " + std::string(300, 'u') + "\r\n";
+    req += "Cookie: " + std::string(4096, 'c') + "\r\n";
+    req += "Accept: text/html,application/xhtml+xml\r\nConnection: keep-alive\r\n\r\n";
+    const char CRLF[] = "\r\n";
+    const char* begin = req.data();
+    const char* end = begin + req.size();
+    const int rounds = 20000;
+
+    // 两种实现每一行的结果必须一致
+    for (const char* p = begin; p < end; ) {
+        const char* a = std::search(p, end, CRLF, CRLF + 2);
+        const char* b = HttpScanner::findCRLF(p, end);
+        assert(a == b);
+        if (a == end) break;
+        p = a + 2;
+    }
+
+    auto scanAll = [&](bool simd) {
+        size_t lines = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++) {
+            for (const char* p = begin; p < end; lines++) {
+                const char* e = simd ? HttpScanner::findCRLF(p, end) : std::search(p, end, CRLF, CRLF + 2);
+                if (e == end) break;
+                p = e + 2;
+            }
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+        std::cout << (simd ? HttpScanner::isaName() : "std::search") << ": "
+                  << ns / rounds << " ns/request, "
+                  << req.size() * rounds / ns << " GB/s (" << lines << " lines)" << std::endl;
+    };
+    scanAll(false);
+    scanAll(true);
+
+    auto tokenAll = [&](bool simd) {
+        std::string name = std::string(4096, 'x');  // 长 token，看校验的吞吐
+        size_t ok = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++) {
+            const char* e = simd ? HttpScanner::findNonToken(name.data(), name.data() + name.size())
+                                 : HttpScanner::findNonTokenScalar(name.data(), name.data() + name.size());
+            ok += (e == name.data() + name.size());
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+        std::cout << "token " << (simd ? HttpScanner::isaName() : "scalar") << ": "
+                  << name.size() * rounds / ns << " GB/s (" << ok << ")" << std::endl;
+    };
+    tokenAll(false);
+    tokenAll(true);
+}
+
+// Buffer 热路径的微基准：解析请求和生成响应时对缓冲区的典型用法
+// 读写位置是普通变量（单一所有者），这里测每次操作的开销；加 -DBUFFER_OWNER_CHECK 编译会带上所有者检查
+void benchBuffer() {
+    const int rounds = 200000;
+    std::string req = "GET /index.html HTTP/1.1\r\nHost: localhost:1316\r\n";
+    req += "User-Agent: " + std::string(120, 'u') + "\r\n";
+    req += "Accept: text/html\r\nConnection: keep-alive\r\n\r\n";
+    const char* headers[] = {"HTTP/1.1 200 OK\r\n", "Date: Sat, 17 Oct 2026 08:00:00 GMT\r\n",
+                             "Connection: keep-alive\r\n", "Content-Type: text/html\r\n",
+                             "Content-Length: 3120\r\n\r\n"};
+    Buffer buff;
+
+    auto report = [](const char* name, std::chrono::steady_clock::time_point t0, long ops, size_t check) {
+        auto t1 = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+        std::cout << name << ": " << ns / ops << " ns/op (" << check << ")" << std::endl;
+    };
+
+    // 生成响应头：一行一个 append，最后整个取走
+    auto t0 = std::chrono::steady_clock::now();
+    size_t bytes = 0;
+    for (int r = 0; r < rounds; r++) {
+        for (const char* h : headers) {
+            buff.append(h);
+        }
+        bytes += buff.readableBytes();
+        buff.retrieveAll();
+    }
+    report("append header", t0, rounds * 5L, bytes);
+
+    // 解析请求：按行找 CRLF，每行读完就 retrieve，和 HttpRequest::parse 的头部状态一样
+    t0 = std::chrono::steady_clock::now();
+    size_t lines = 0;
+    for (int r = 0; r < rounds; r++) {
+        buff.append(req);
+        while (buff.readableBytes() > 0) {
+            const char* p = buff.peekContiguous(buff.readableBytes());
+            const char* end = HttpScanner::findCRLF(p, p + buff.readableBytes());
+            buff.retrieve(end - p + 2);
+            lines++;
+        }
+    }
+    report("parse line", t0, lines, lines);
+
+    // 只查询长度，看读写位置本身的开销
+    buff.append(req);
+    t0 = std::chrono::steady_clock::now();
+    size_t sum = 0;
+    for (int r = 0; r < rounds * 10; r++) {
+        sum += buff.readableBytes() + buff.writeableBytes();
+        asm volatile("" : : "r"(sum));  // 不让编译器把循环算掉
+    }
+    report("readableBytes", t0, rounds * 10L, sum);
+    buff.retrieveAll();
+
+    // 流水线：一次读进很多小请求，逐个 retrieve，测跨段的 retrieve 和 peekAt
+    std::string batch;
+    for (int i = 0; i < 16; i++) {
+        batch += req;
+    }
+    t0 = std::chrono::steady_clock::now();
+    size_t pieces = 0;
+    for (int r = 0; r < rounds / 16; r++) {
+        buff.append(batch);
+        while (buff.readableBytes() > 0) {
+            size_t len = 0;
+            buff.peekAt(0, &len);
+            buff.retrieve(std::min(len, req.size()));
+            pieces++;
+        }
+    }
+    report("pipeline retrieve", t0, pieces, pieces);
+}
+
 int main(){
     // testLog();
+    // benchScanner();
+    // benchBuffer();
     testThreadPool();
     std::cout<<"main函数结束"<<std::endl;
     return 0;